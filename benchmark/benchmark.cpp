@@ -0,0 +1,396 @@
+#include <vector>
+#include <map>
+#include <string>
+#include <tuple>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+
+#include "msgpack.hpp"
+#include "allocation_counter.hpp"
+
+using namespace std;
+
+// pack / unpack throughput per type family on fixed-seed datasets, latency percentiles of small messages and heap
+// allocations per operation, printed as a table or (--json) as one json document for comparing releases
+//   benchmark [--json] [--filter substring] [--min-time seconds]
+
+// options
+
+bool json_output = false;
+string filter;
+double min_time = 0.5;
+
+// results
+
+struct throughput {
+	string name;
+	string op;
+	uint64_t bytes; // packed size
+	uint64_t items; // top level elements
+	double seconds; // median of one operation
+	double allocs; // per operation
+};
+
+struct latency {
+	string name;
+	string op;
+	uint64_t bytes;
+	uint64_t samples;
+	double p50;
+	double p99;
+	double p999;
+	double allocs;
+};
+
+vector<throughput> throughputs;
+vector<latency> latencies;
+
+typedef chrono::steady_clock bench_clock;
+
+double elapsed(bench_clock::time_point start, bench_clock::time_point end) {
+	return chrono::duration<double>(end - start).count();
+}
+
+// runs op until min_time has passed (at least 3 times), returns the median run time, allocations of one run in allocs
+double measure(const function<void()>& op, double& allocs) {
+	allocations = 0;
+	counting_allocations = true;
+	op();
+	counting_allocations = false;
+	allocs = double(allocations);
+	vector<double> runs;
+	auto begin = bench_clock::now();
+	while (runs.size() < 3 || elapsed(begin, bench_clock::now()) < min_time) {
+		auto start = bench_clock::now();
+		op();
+		runs.push_back(elapsed(start, bench_clock::now()));
+	}
+	sort(runs.begin(), runs.end());
+	return runs[runs.size() / 2];
+}
+
+bool selected(const string& name) {
+	return filter.empty() || name.find(filter) != string::npos;
+}
+
+template<typename T>
+void bench_throughput(const string& name, T& data) {
+	if (!selected(name)) {
+		return;
+	}
+	msgpack_byte::container packed;
+	msgpack::pack(data, packed);
+	throughput pack_result = { name, "pack", packed.size(), data.size(), 0, 0 };
+	pack_result.seconds = measure([&]() {
+		msgpack_byte::container dest;
+		msgpack::pack(data, dest);
+	}, pack_result.allocs);
+	throughputs.push_back(pack_result);
+
+	throughput unpack_result = { name, "unpack", packed.size(), data.size(), 0, 0 };
+	unpack_result.seconds = measure([&]() {
+		T dest;
+		uint64_t pos = 0;
+		msgpack::unpack(dest, packed, pos);
+	}, unpack_result.allocs);
+	throughputs.push_back(unpack_result);
+
+	// the bytes as fresh untrusted input every run, validated before they are decoded
+	throughput untrusted_result = { name, "unpack_untrusted", packed.size(), data.size(), 0, 0 };
+	untrusted_result.seconds = measure([&]() {
+		T dest;
+		msgpack_byte::container input(packed.raw_pointer(), packed.size());
+		uint64_t pos = 0;
+		msgpack::unpack(dest, input, pos);
+	}, untrusted_result.allocs);
+	throughputs.push_back(untrusted_result);
+
+	T check;
+	uint64_t pos = 0;
+	msgpack::unpack(check, packed, pos);
+	if (!(check == data)) {
+		cerr << name << ": unpacked data differs!" << endl;
+	}
+}
+
+// every message on its own, packed into a reused container and unpacked into a reused object
+template<typename T>
+void bench_latency(const string& name, vector<T>& messages) {
+	if (!selected(name)) {
+		return;
+	}
+	const size_t rounds = 5;
+	msgpack_byte::container dest(0x1000);
+	vector<msgpack_byte::container> packed(messages.size());
+	for (size_t i = 0; i < messages.size(); i++) {
+		msgpack::pack(messages[i], packed[i]);
+	}
+	vector<double> pack_times;
+	vector<double> unpack_times;
+	pack_times.reserve(messages.size() * rounds);
+	unpack_times.reserve(messages.size() * rounds);
+	T out;
+	uint64_t pack_allocs = 0;
+	uint64_t unpack_allocs = 0;
+	for (size_t round = 0; round <= rounds; round++) {
+		bool warmup = round == 0;
+		for (size_t i = 0; i < messages.size(); i++) {
+			dest.consume(dest.size());
+			allocations = 0;
+			counting_allocations = !warmup;
+			auto start = bench_clock::now();
+			msgpack::pack(messages[i], dest);
+			auto middle = bench_clock::now();
+			counting_allocations = false;
+			pack_allocs += allocations;
+			allocations = 0;
+			counting_allocations = !warmup;
+			uint64_t pos = 0;
+			auto restart = bench_clock::now();
+			msgpack::unpack(out, packed[i], pos);
+			auto end = bench_clock::now();
+			counting_allocations = false;
+			unpack_allocs += allocations;
+			if (!warmup) {
+				pack_times.push_back(elapsed(start, middle));
+				unpack_times.push_back(elapsed(restart, end));
+			}
+		}
+	}
+	uint64_t bytes = 0;
+	for (auto& p : packed) {
+		bytes += p.size();
+	}
+	auto percentiles = [&](const string& op, vector<double>& times, uint64_t allocs) {
+		sort(times.begin(), times.end());
+		auto at = [&](double q) {
+			return times[min(times.size() - 1, size_t(q * double(times.size())))];
+		};
+		latencies.push_back({ name, op, bytes / messages.size(), times.size(), at(0.5), at(0.99), at(0.999), double(allocs) / double(times.size()) });
+	};
+	percentiles("pack", pack_times, pack_allocs);
+	percentiles("unpack", unpack_times, unpack_allocs);
+}
+
+// datasets, all drawn from one fixed seed so every run and release packs the same bytes
+
+mt19937_64 generator(42);
+
+int64_t uniform(int64_t low, int64_t high) {
+	return uniform_int_distribution<int64_t>(low, high)(generator);
+}
+
+string random_string(size_t low, size_t high) {
+	string result(size_t(uniform(int64_t(low), int64_t(high))), ' ');
+	for (auto& c : result) {
+		c = char(uniform('a', 'z'));
+	}
+	return result;
+}
+
+struct record {
+	uint64_t id;
+	string name;
+	double score;
+	vector<int32_t> tags;
+	map<string, int64_t> counters;
+	msgpack_define_map(id, name, score, tags, counters)
+
+	bool operator==(const record& other) const {
+		return id == other.id && name == other.name && score == other.score && tags == other.tags && counters == other.counters;
+	}
+};
+
+record random_record() {
+	record r;
+	r.id = uint64_t(uniform(0, INT64_MAX));
+	r.name = random_string(4, 24);
+	r.score = double(uniform(0, 1000000)) / 7.0;
+	r.tags.resize(size_t(uniform(0, 6)));
+	for (auto& t : r.tags) {
+		t = int32_t(uniform(-1000, 1000));
+	}
+	for (int64_t i = uniform(0, 4); i > 0; i--) {
+		r.counters[random_string(3, 10)] = uniform(0, 1 << 20);
+	}
+	return r;
+}
+
+string simd_name() {
+	switch (msgpack::simd::level()) {
+	case msgpack::simd::isa::avx2: {
+		return "avx2";
+	}
+	case msgpack::simd::isa::sse42: {
+		return "sse4.2";
+	}
+	default: {
+		return "scalar";
+	}
+	}
+}
+
+string compiler_name() {
+#if defined(__clang__)
+	return string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+	return string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+	return "msvc " + to_string(_MSC_VER);
+#else
+	return "unknown";
+#endif
+}
+
+string quoted(const string& text) {
+	string result = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			result += '\\';
+		}
+		result += c;
+	}
+	return result + "\"";
+}
+
+void print_json() {
+	ostringstream out;
+	out << fixed;
+	out.precision(3);
+	out << "{\n  \"compiler\": " << quoted(compiler_name()) << ",\n  \"simd\": " << quoted(simd_name()) << ",\n  \"throughput\": [";
+	for (size_t i = 0; i < throughputs.size(); i++) {
+		const throughput& t = throughputs[i];
+		out << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << quoted(t.name) << ", \"op\": " << quoted(t.op) << ", \"bytes\": " << t.bytes
+			<< ", \"items\": " << t.items << ", \"ns_per_op\": " << t.seconds * 1e9 << ", \"mb_per_s\": " << double(t.bytes) / t.seconds / 1e6
+			<< ", \"items_per_s\": " << double(t.items) / t.seconds << ", \"allocs_per_op\": " << t.allocs << "}";
+	}
+	out << "\n  ],\n  \"latency\": [";
+	for (size_t i = 0; i < latencies.size(); i++) {
+		const latency& l = latencies[i];
+		out << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << quoted(l.name) << ", \"op\": " << quoted(l.op) << ", \"bytes\": " << l.bytes
+			<< ", \"samples\": " << l.samples << ", \"p50_ns\": " << l.p50 * 1e9 << ", \"p99_ns\": " << l.p99 * 1e9 << ", \"p999_ns\": " << l.p999 * 1e9
+			<< ", \"allocs_per_op\": " << l.allocs << "}";
+	}
+	out << "\n  ]\n}\n";
+	cout << out.str();
+}
+
+void print_table() {
+	printf("%s, simd %s\n\n", compiler_name().c_str(), simd_name().c_str());
+	printf("%-16s %-16s %12s %10s %14s %12s\n", "dataset", "op", "bytes", "MB/s", "items/s", "allocs/op");
+	for (auto& t : throughputs) {
+		printf("%-16s %-16s %12llu %10.1f %14.0f %12.0f\n", t.name.c_str(), t.op.c_str(), (unsigned long long)t.bytes, double(t.bytes) / t.seconds / 1e6, double(t.items) / t.seconds, t.allocs);
+	}
+	printf("\n%-16s %-16s %12s %10s %10s %10s %12s\n", "message", "op", "bytes", "p50 ns", "p99 ns", "p99.9 ns", "allocs/op");
+	for (auto& l : latencies) {
+		printf("%-16s %-16s %12llu %10.0f %10.0f %10.0f %12.2f\n", l.name.c_str(), l.op.c_str(), (unsigned long long)l.bytes, l.p50 * 1e9, l.p99 * 1e9, l.p999 * 1e9, l.allocs);
+	}
+}
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--json") {
+			json_output = true;
+		}
+		else if (arg == "--filter" && i + 1 < argc) {
+			filter = argv[++i];
+		}
+		else if (arg == "--min-time" && i + 1 < argc) {
+			min_time = atof(argv[++i]);
+		}
+		else {
+			cerr << "usage: " << argv[0] << " [--json] [--filter substring] [--min-time seconds]" << endl;
+			return 1;
+		}
+	}
+
+	vector<int32_t> small_ints(1000000);
+	for (auto& v : small_ints) {
+		v = int32_t(uniform(0, 127));
+	}
+	bench_throughput("small_ints", small_ints);
+
+	vector<int64_t> wide_ints(1000000);
+	for (auto& v : wide_ints) {
+		v = uniform(INT64_MIN, INT64_MAX);
+	}
+	bench_throughput("wide_ints", wide_ints);
+
+	vector<double> doubles(1000000);
+	for (auto& v : doubles) {
+		v = double(uniform(-1000000000, 1000000000)) / 3.0;
+	}
+	bench_throughput("doubles", doubles);
+
+	vector<string> short_strings(300000);
+	for (auto& v : short_strings) {
+		v = random_string(1, 16);
+	}
+	bench_throughput("short_strings", short_strings);
+
+	vector<string> long_strings(5000);
+	for (auto& v : long_strings) {
+		v = random_string(256, 4096);
+	}
+	bench_throughput("long_strings", long_strings);
+
+	vector<map<string, map<string, int64_t>>> nested_maps(20000);
+	for (auto& v : nested_maps) {
+		for (int64_t i = uniform(1, 6); i > 0; i--) {
+			auto& inner = v[random_string(4, 12)];
+			for (int64_t j = uniform(1, 6); j > 0; j--) {
+				inner[random_string(4, 12)] = uniform(-100000, 100000);
+			}
+		}
+	}
+	bench_throughput("nested_maps", nested_maps);
+
+	vector<vector<vector<vector<vector<vector<int32_t>>>>>> deep_nesting(2000);
+	for (auto& a : deep_nesting) {
+		a.resize(3);
+		for (auto& b : a) {
+			b.resize(3);
+			for (auto& c : b) {
+				c.resize(3);
+				for (auto& d : c) {
+					d.resize(3);
+					for (auto& e : d) {
+						e.resize(size_t(uniform(1, 5)));
+						for (auto& v : e) {
+							v = int32_t(uniform(-1000, 1000));
+						}
+					}
+				}
+			}
+		}
+	}
+	bench_throughput("deep_nesting", deep_nesting);
+
+	vector<record> records(100000);
+	for (auto& v : records) {
+		v = random_record();
+	}
+	bench_throughput("records", records);
+
+	vector<record> messages(20000);
+	for (auto& v : messages) {
+		v = random_record();
+	}
+	bench_latency("small_message", messages);
+
+	if (json_output) {
+		print_json();
+	}
+	else {
+		print_table();
+	}
+	return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+
+// heap allocations are counted while counting_allocations is set, shared by test.cpp and the benchmark
+// the replacement operators below are not inline, include this header in exactly one translation unit of a program
+inline std::atomic<bool> counting_allocations(false);
+inline std::atomic<uint64_t> allocations(0);
+
+namespace allocation_counter_detail {
+	inline void* allocate(size_t size) noexcept {
+		if (counting_allocations.load(std::memory_order_relaxed)) {
+			allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+		return std::malloc(size == 0 ? 1 : size);
+	}
+
+	// kept out of line, gcc warns about free on memory from operator new when it inlines it into standard containers
+#ifdef __GNUC__
+	__attribute__((noinline))
+#endif
+	inline void release(void* p) noexcept {
+		std::free(p);
+	}
+};
+
+// the whole family is replaced so every form of new and delete pairs malloc with free
+
+void* operator new(size_t size) {
+	void* p = allocation_counter_detail::allocate(size);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size) {
+	void* p = allocation_counter_detail::allocate(size);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return allocation_counter_detail::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return allocation_counter_detail::allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+	allocation_counter_detail::release(p);
+}
+
+void operator delete[](void* p) noexcept {
+	allocation_counter_detail::release(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	allocation_counter_detail::release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	allocation_counter_detail::release(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+	allocation_counter_detail::release(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+	allocation_counter_detail::release(p);
+}
+
+#endif
@@ -0,0 +1,467 @@
+#ifndef COMPRESS_HPP
+#define COMPRESS_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "msgpack.hpp"
+#include "parallel.hpp"
+
+#if defined(with_zlib) && __has_include(<zlib.h>)
+#define msgpack_zlib
+#include <zlib.h>
+#endif
+#if defined(with_zstd) && __has_include(<zstd.h>)
+#define msgpack_zstd
+#include <zstd.h>
+#endif
+
+namespace msgpack {
+	// block compression: output is cut into blocks of at most block_size bytes that are compressed and decompressed
+	// independently, each one is [codec id, 1][original length, 4][stored length, 4][stored bytes] (big endian) and is
+	// stored uncompressed (codec 0) whenever the codec does not make it smaller
+
+	// codecs compress a whole block at once, compress may keep scratch state (one instance per stream or thread),
+	// decompress must be safe to call concurrently
+
+	class codec {
+	public:
+
+		virtual ~codec() = default;
+
+		// written into every block, 0 to 0x7F are reserved for the codecs below
+		virtual uint8_t id() const = 0;
+		// largest output compress can produce for len bytes
+		virtual size_t bound(size_t len) const = 0;
+		// compresses len bytes into dest (bound(len) bytes available), returns the compressed size
+		virtual size_t compress(const uint8_t* src, size_t len, uint8_t* dest) = 0;
+		// restores exactly original bytes into dest, throws std::invalid_argument on corrupt input
+		virtual void decompress(const uint8_t* src, size_t len, uint8_t* dest, size_t original) const = 0;
+		// largest original length len stored bytes can restore to, blocks claiming more are rejected before any memory
+		// is reserved for them
+		virtual size_t max_original(size_t len) const = 0;
+	};
+
+	// len * factor, clamped instead of wrapping around
+	constexpr size_t expansion_limit(size_t len, size_t factor) {
+		return len > SIZE_MAX / factor ? SIZE_MAX : len * factor;
+	}
+
+	class stored_codec : public codec {
+	public:
+
+		uint8_t id() const override {
+			return 0;
+		}
+		size_t bound(size_t len) const override {
+			return len;
+		}
+		size_t compress(const uint8_t* src, size_t len, uint8_t* dest) override {
+			memcpy(dest, src, len);
+			return len;
+		}
+		void decompress(const uint8_t* src, size_t len, uint8_t* dest, size_t original) const override {
+			if (len != original) {
+				throw std::invalid_argument("stored block length mismatch!");
+			}
+			memcpy(dest, src, len);
+		}
+		size_t max_original(size_t len) const override {
+			return len;
+		}
+	};
+
+	// byte oriented LZ77 in the LZ4 block layout: [token: literal length, match length - 4][literals][offset, 2, little
+	// endian][length extensions] per sequence, the last sequence holds literals only, level 1 (fastest) to 9 trades
+	// speed for ratio through the size of the match table and how fast incompressible input is skipped
+
+	class lz_codec : public codec {
+	public:
+
+		lz_codec(int level = 1) : bits(12 + (std::clamp(level, 1, 9) - 1) / 2), shift(std::clamp(level, 1, 9) + 4), table(size_t(1) << bits) {};
+
+		uint8_t id() const override {
+			return 1;
+		}
+		size_t bound(size_t len) const override {
+			return len + len / 255 + 16;
+		}
+		size_t compress(const uint8_t* src, size_t len, uint8_t* dest) override {
+			std::fill(table.begin(), table.end(), 0); // positions + 1, 0 is empty
+			uint8_t* out = dest;
+			size_t anchor = 0;
+			size_t pos = 0;
+			size_t misses = 0;
+			// matches start at least 12 bytes and end at least 5 bytes before the end, like LZ4
+			size_t limit = len < 13 ? 0 : len - 12;
+			while (pos < limit) {
+				uint32_t word = load(src + pos);
+				uint32_t& slot = table[(word * 2654435761u) >> (32 - bits)];
+				size_t ref = slot;
+				slot = uint32_t(pos + 1);
+				if (ref == 0 || pos + 1 - ref > 0xFFFF || load(src + ref - 1) != word) {
+					pos += 1 + (misses++ >> shift);
+					continue;
+				}
+				ref--;
+				size_t length = 4;
+				while (pos + length < len - 5 && src[ref + length] == src[pos + length]) {
+					length++;
+				}
+				while (pos > anchor && ref > 0 && src[pos - 1] == src[ref - 1]) {
+					pos--;
+					ref--;
+					length++;
+				}
+				out = sequence(out, src + anchor, pos - anchor, pos - ref, length);
+				pos += length;
+				anchor = pos;
+				misses = 0;
+			}
+			out = sequence(out, src + anchor, len - anchor, 0, 0);
+			return size_t(out - dest);
+		}
+		void decompress(const uint8_t* src, size_t len, uint8_t* dest, size_t original) const override {
+			size_t in = 0;
+			size_t out = 0;
+			while (true) {
+				if (in >= len) {
+					throw std::invalid_argument("truncated lz block!");
+				}
+				uint8_t token = src[in++];
+				size_t literals = extend(token >> 4, src, len, in);
+				if (literals > len - in || literals > original - out) {
+					throw std::invalid_argument("lz literals out of range!");
+				}
+				memcpy(dest + out, src + in, literals);
+				in += literals;
+				out += literals;
+				if (in == len) {
+					break;
+				}
+				if (len - in < 2) {
+					throw std::invalid_argument("truncated lz block!");
+				}
+				size_t offset = size_t(src[in]) | size_t(src[in + 1]) << 8;
+				in += 2;
+				size_t length = extend(token & 0x0F, src, len, in) + 4;
+				if (offset == 0 || offset > out || length > original - out) {
+					throw std::invalid_argument("lz match out of range!");
+				}
+				const uint8_t* from = dest + out - offset;
+				if (offset >= length) {
+					memcpy(dest + out, from, length);
+				}
+				else {
+					for (size_t i = 0; i < length; i++) {
+						dest[out + i] = from[i]; // overlapping, repeats the last offset bytes
+					}
+				}
+				out += length;
+			}
+			if (out != original) {
+				throw std::invalid_argument("lz block length mismatch!");
+			}
+		}
+		size_t max_original(size_t len) const override {
+			return expansion_limit(len, 255); // a length extension byte adds at most 255 bytes
+		}
+
+	private:
+
+		static uint32_t load(const uint8_t* src) {
+			uint32_t word;
+			memcpy(&word, src, 4);
+			return word;
+		}
+
+		// lengths of 15 and more continue in bytes of 255 until a smaller one
+		static uint8_t* length_bytes(uint8_t* out, size_t n) {
+			for (; n >= 255; n -= 255) {
+				*out++ = 255;
+			}
+			*out++ = uint8_t(n);
+			return out;
+		}
+		static size_t extend(size_t n, const uint8_t* src, size_t len, size_t& in) {
+			if (n == 15) {
+				uint8_t more;
+				do {
+					if (in >= len) {
+						throw std::invalid_argument("truncated lz block!");
+					}
+					more = src[in++];
+					n += more;
+				} while (more == 255);
+			}
+			return n;
+		}
+
+		// one sequence, length 0 means literals only (the last one)
+		static uint8_t* sequence(uint8_t* out, const uint8_t* literals, size_t count, size_t offset, size_t length) {
+			size_t match = length == 0 ? 0 : length - 4;
+			uint8_t* token = out++;
+			*token = uint8_t((count >= 15 ? 15 : count) << 4);
+			if (count >= 15) {
+				out = length_bytes(out, count - 15);
+			}
+			memcpy(out, literals, count);
+			out += count;
+			if (length == 0) {
+				return out;
+			}
+			*out++ = uint8_t(offset);
+			*out++ = uint8_t(offset >> 8);
+			*token |= uint8_t(match >= 15 ? 15 : match);
+			if (match >= 15) {
+				out = length_bytes(out, match - 15);
+			}
+			return out;
+		}
+
+		int bits;
+		int shift;
+		std::vector<uint32_t> table;
+	};
+
+#ifdef msgpack_zlib
+	// zlib (deflate), compile with with_zlib defined and link zlib
+
+	class zlib_codec : public codec {
+	public:
+
+		zlib_codec(int level = Z_DEFAULT_COMPRESSION) : level(level) {};
+
+		uint8_t id() const override {
+			return 2;
+		}
+		size_t bound(size_t len) const override {
+			return size_t(compressBound(uLong(len)));
+		}
+		size_t compress(const uint8_t* src, size_t len, uint8_t* dest) override {
+			uLongf size = uLongf(bound(len));
+			if (compress2(dest, &size, src, uLong(len), level) != Z_OK) {
+				throw std::runtime_error("zlib compression failed!");
+			}
+			return size_t(size);
+		}
+		void decompress(const uint8_t* src, size_t len, uint8_t* dest, size_t original) const override {
+			uLongf size = uLongf(original);
+			if (uncompress(dest, &size, src, uLong(len)) != Z_OK || size != original) {
+				throw std::invalid_argument("corrupt zlib block!");
+			}
+		}
+		size_t max_original(size_t len) const override {
+			return expansion_limit(len, 1032); // the deflate maximum
+		}
+
+	private:
+
+		int level;
+	};
+#endif
+
+#ifdef msgpack_zstd
+	// zstandard, compile with with_zstd defined and link libzstd
+
+	class zstd_codec : public codec {
+	public:
+
+		zstd_codec(int level = 3) : level(level) {};
+
+		uint8_t id() const override {
+			return 3;
+		}
+		size_t bound(size_t len) const override {
+			return ZSTD_compressBound(len);
+		}
+		size_t compress(const uint8_t* src, size_t len, uint8_t* dest) override {
+			size_t size = ZSTD_compress(dest, bound(len), src, len, level);
+			if (ZSTD_isError(size)) {
+				throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(size));
+			}
+			return size;
+		}
+		void decompress(const uint8_t* src, size_t len, uint8_t* dest, size_t original) const override {
+			size_t size = ZSTD_decompress(dest, original, src, len);
+			if (ZSTD_isError(size) || size != original) {
+				throw std::invalid_argument("corrupt zstd block!");
+			}
+		}
+		size_t max_original(size_t len) const override {
+			return expansion_limit(len, 0x8000); // at least 4 bytes per block of at most 128 KB
+		}
+
+	private:
+
+		int level;
+	};
+#endif
+
+	// codecs by id for decompression, the built-in ones are always known, others are added with register_codec
+
+	inline codec*& codec_slot(uint8_t id) {
+		static codec* slots[256] = {};
+		return slots[id];
+	}
+
+	void register_codec(codec& c) {
+		codec_slot(c.id()) = &c;
+	}
+
+	inline const codec& find_codec(uint8_t id) {
+		if (codec_slot(id) != nullptr) {
+			return *codec_slot(id);
+		}
+		static stored_codec stored;
+		static lz_codec lz;
+		switch (id) {
+		case 0: {
+			return stored;
+		}
+		case 1: {
+			return lz;
+		}
+#ifdef msgpack_zlib
+		case 2: {
+			static zlib_codec zlib;
+			return zlib;
+		}
+#endif
+#ifdef msgpack_zstd
+		case 3: {
+			static zstd_codec zstd;
+			return zstd;
+		}
+#endif
+		}
+		throw std::invalid_argument("unknown codec " + std::to_string(id) + "!");
+	}
+
+	constexpr size_t block_header_size = 9;
+
+	// compresses one block into dest, scratch is reused across calls
+	template<typename Sink>
+	void compress_block(const uint8_t* src, size_t len, codec& method, Sink& dest, std::vector<uint8_t>& scratch) {
+		scratch.resize(std::max(scratch.size(), method.bound(len)));
+		size_t size = len == 0 ? 0 : method.compress(src, len, scratch.data());
+		bool stored = size >= len;
+		dest.push_back(uint8_t(stored ? 0 : method.id()));
+		dest.push_back(uint32_t(len));
+		dest.push_back(uint32_t(stored ? len : size));
+		if (stored) {
+			dest.push_back(reinterpret_cast<const char*>(src), uint32_t(len));
+		}
+		else {
+			dest.push_back(reinterpret_cast<const char*>(scratch.data()), uint32_t(size));
+		}
+	}
+
+	// one compressed block as found in the input
+	struct compressed_block {
+		uint8_t id;
+		uint64_t offset; // of the stored bytes
+		size_t size;
+		size_t original;
+	};
+
+	// walks the block headers without decompressing anything
+	std::vector<compressed_block> compressed_blocks(const uint8_t* src, size_t len) {
+		std::vector<compressed_block> blocks;
+		uint64_t pos = 0;
+		while (pos < len) {
+			if (len - pos < block_header_size) {
+				throw std::out_of_range("truncated block header at " + std::to_string(pos) + "!");
+			}
+			compressed_block block = { src[pos], pos + block_header_size, read_d_word(src + pos + 5), read_d_word(src + pos + 1) };
+			if (block.size > len - block.offset) {
+				throw std::out_of_range("truncated block at " + std::to_string(pos) + "!");
+			}
+			blocks.push_back(block);
+			pos = block.offset + block.size;
+		}
+		return blocks;
+	}
+
+	// compresses every byte of src into dest in blocks of block_size
+	void compress(container& src, container& dest, codec& method, size_t block_size = 0x10000) {
+		std::vector<uint8_t> scratch;
+		size_t len = src.size();
+		dest.check_resize(len / 2 + block_header_size);
+		for (size_t at = 0; at < len; at += block_size) {
+			compress_block(src.raw_pointer(at), std::min(block_size, len - at), method, dest, scratch);
+		}
+	}
+
+	// appends the decompressed blocks of src to dest, on threads workers when more than one (0 means one per hardware
+	// thread), every block lands at its offset from a prefix sum of the original lengths
+	void decompress(const uint8_t* src, size_t len, container& dest, unsigned threads = 1) {
+		std::vector<compressed_block> blocks = compressed_blocks(src, len);
+		std::vector<size_t> offsets(blocks.size() + 1, 0);
+		for (size_t k = 0; k < blocks.size(); k++) {
+			// the lengths are untrusted, nothing is reserved for a block its codec cannot expand to
+			if (blocks[k].original > find_codec(blocks[k].id).max_original(blocks[k].size)) {
+				throw std::invalid_argument("block original length out of range at " + std::to_string(blocks[k].offset - block_header_size) + "!");
+			}
+			offsets[k + 1] = offsets[k] + blocks[k].original;
+		}
+		dest.check_resize(offsets.back());
+		uint8_t* base = dest.mutable_pointer(dest.size());
+		auto task = [&](size_t k) {
+			const compressed_block& block = blocks[k];
+			find_codec(block.id).decompress(src + block.offset, block.size, base + offsets[k], block.original);
+		};
+		if (threads == 0) {
+			threads = parallel_threads();
+		}
+		if (threads > 1) {
+			parallel_for(blocks.size(), threads, task);
+		}
+		else {
+			for (size_t k = 0; k < blocks.size(); k++) {
+				task(k);
+			}
+		}
+		dest.commit(offsets.back());
+	}
+
+	void decompress(container& src, container& dest, unsigned threads = 1) {
+		decompress(src.raw_pointer(), src.size(), dest, threads);
+	}
+
+	// output sink compressing everything written to it into blocks on the underlying sink (a container, fd_sink,
+	// ostream_sink, ...), the open block is written on flush() and on destruction
+
+	template<typename Sink>
+	class compress_sink : public staged_sink<compress_sink<Sink>> {
+	public:
+
+		compress_sink(Sink& sink, codec& method, size_t block_size = 0x10000) : staged_sink<compress_sink<Sink>>(block_size), out(sink), method(method), limit(block_size) {};
+		~compress_sink() {
+			try {
+				this->flush();
+			}
+			catch (...) { }
+		}
+
+		void drain(const uint8_t* src, size_t len) {
+			for (size_t at = 0; at < len; at += limit) {
+				compress_block(src + at, std::min(limit, len - at), method, out, scratch);
+			}
+		}
+
+	private:
+
+		Sink& out;
+		codec& method;
+		size_t limit;
+		std::vector<uint8_t> scratch;
+	};
+};
+
+#endif
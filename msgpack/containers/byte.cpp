@@ -6,13 +6,41 @@
 #include <bitset>
 
 #include "byte.hpp"
+#include "stats.hpp"
 #include "../formats.hpp"
 
 namespace msgpack_byte {
 	// constructors
 
+	container::container(const container& other) : data(other.foreign ? other.data : new uint8_t[other.s + 1]), s(other.s), c(other.foreign ? other.c : other.s + 1), foreign(other.foreign), valid_from(other.valid_from), valid(other.valid) {
+		if (!foreign) {
+			std::copy(other.data, other.data + s, data);
+		}
+	}
+
+	container::container(container&& other) noexcept : data(other.data), s(other.s), c(other.c), foreign(other.foreign), valid_from(other.valid_from), valid(other.valid), deleter(std::move(other.deleter)) {
+		other.s = 0;
+		other.valid_from = 0;
+		other.valid = 0;
+		other.c = 0;
+		other.data = nullptr;
+		other.foreign = true; // nothing left to release
+		other.deleter = nullptr;
+	}
+
+	container& container::operator=(container other) noexcept {
+		std::swap(s, other.s);
+		std::swap(c, other.c);
+		std::swap(data, other.data);
+		std::swap(foreign, other.foreign);
+		std::swap(valid_from, other.valid_from);
+		std::swap(valid, other.valid);
+		std::swap(deleter, other.deleter);
+		return *this;
+	}
+
 	container::~container() {
-		delete[] data;
+		release();
 	}
 
 	// operators
@@ -21,6 +49,17 @@ namespace msgpack_byte {
 		if (i >= c) {
 			throw std::out_of_range(std::to_string(i) + " out of range!");
 		}
+		if (foreign) {
+			reallocate(c); // borrowed bytes are read-only, the first write copies them
+		}
+		drop_validated(i);
+		return data[i];
+	}
+
+	uint8_t container::operator[] (int i) const {
+		if (size_t(i) >= c) {
+			throw std::out_of_range(std::to_string(i) + " out of range!");
+		}
 		return data[i];
 	}
 
@@ -53,144 +92,92 @@ namespace msgpack_byte {
 	// insertion
 
 	void container::push_back(uint8_t value) {
+		check_expand();
 		data[s] = value;
 		s++;
-		check_expand();
 	}
 
 	void container::push_back(uint8_t* value) {
+		check_expand();
 		data[s] = *value;
 		s++;
-		check_expand();
 	}
 
 	void container::push_back(uint16_t value) {
 		check_resize(2);
-		data[s] = ((value & 0xFF00) >> 8);
-		data[s + 1] = (value & 0x00FF);
+		store_word(data + s, value);
 		s += 2;
-		check_expand();
 	}
 
 	void container::push_back(uint16_t* value) {
 		check_resize(2);
-		data[s] = ((*value & 0xFF00) >> 8);
-		data[s + 1] = (*value & 0x00FF);
+		store_word(data + s, *value);
 		s += 2;
-		check_expand();
 	}
 
 	void container::push_back(uint32_t value) {
 		check_resize(4);
-		data[s] = ((value & 0xFF000000) >> 24);
-		data[s + 1] = ((value & 0x00FF0000) >> 16);
-		data[s + 2] = ((value & 0x0000FF00) >> 8);
-		data[s + 3] = (value & 0x000000FF);
+		store_d_word(data + s, value);
 		s += 4;
-		check_expand();
 	}
 
 	void container::push_back(uint32_t* value) {
 		check_resize(4);
-		data[s] = ((*value & 0xFF000000) >> 24);
-		data[s + 1] = ((*value & 0x00FF0000) >> 16);
-		data[s + 2] = ((*value & 0x0000FF00) >> 8);
-		data[s + 3] = (*value & 0x000000FF);
+		store_d_word(data + s, *value);
 		s += 4;
-		check_expand();
 	}
 
 	void container::push_back(uint64_t value) {
 		check_resize(8);
-		data[s] = ((value & 0xFF00000000000000) >> 56);
-		data[s + 1] = ((value & 0x00FF000000000000) >> 48);
-		data[s + 2] = ((value & 0x0000FF0000000000) >> 40);
-		data[s + 3] = ((value & 0x000000FF00000000) >> 32);
-		data[s + 4] = ((value & 0x00000000FF000000) >> 24);
-		data[s + 5] = ((value & 0x0000000000FF0000) >> 16);
-		data[s + 6] = ((value & 0x000000000000FF00) >> 8);
-		data[s + 7] = (value & 0x00000000000000FF);
+		store_q_word(data + s, value);
 		s += 8;
-		check_expand();
 	}
 
 	void container::push_back(uint64_t* value) {
 		check_resize(8);
-		data[s] = ((*value & 0xFF00000000000000) >> 56);
-		data[s + 1] = ((*value & 0x00FF000000000000) >> 48);
-		data[s + 2] = ((*value & 0x0000FF0000000000) >> 40);
-		data[s + 3] = ((*value & 0x000000FF00000000) >> 32);
-		data[s + 4] = ((*value & 0x00000000FF000000) >> 24);
-		data[s + 5] = ((*value & 0x0000000000FF0000) >> 16);
-		data[s + 6] = ((*value & 0x000000000000FF00) >> 8);
-		data[s + 7] = (*value & 0x00000000000000FF);
+		store_q_word(data + s, *value);
 		s += 8;
-		check_expand();
 	}
 
 	void container::push_back(float value) {
 		check_resize(4);
-		uint8_t* float_bytes = reinterpret_cast<uint8_t*>(&value);
-		push_back(float_bytes[3]);
-		push_back(float_bytes[2]);
-		push_back(float_bytes[1]);
-		push_back(float_bytes[0]);
+		store_d_word(data + s, value);
+		s += 4;
 	}
 
 	void container::push_back(float* value) {
 		check_resize(4);
-		uint8_t* float_bytes = reinterpret_cast<uint8_t*>(value);
-		push_back(float_bytes[3]);
-		push_back(float_bytes[2]);
-		push_back(float_bytes[1]);
-		push_back(float_bytes[0]);
+		store_d_word(data + s, *value);
+		s += 4;
 	}
 
 	void container::push_back(double value) {
 		check_resize(8);
-		uint8_t* double_bytes = reinterpret_cast<uint8_t*>(&value);
-		push_back(double_bytes[7]);
-		push_back(double_bytes[6]);
-		push_back(double_bytes[5]);
-		push_back(double_bytes[4]);
-		push_back(double_bytes[3]);
-		push_back(double_bytes[2]);
-		push_back(double_bytes[1]);
-		push_back(double_bytes[0]);
+		store_q_word(data + s, value);
+		s += 8;
 	}
 
 	void container::push_back(double* value) {
 		check_resize(8);
-		uint8_t* double_bytes = reinterpret_cast<uint8_t*>(value);
-		push_back(double_bytes[7]);
-		push_back(double_bytes[6]);
-		push_back(double_bytes[5]);
-		push_back(double_bytes[4]);
-		push_back(double_bytes[3]);
-		push_back(double_bytes[2]);
-		push_back(double_bytes[1]);
-		push_back(double_bytes[0]);
+		store_q_word(data + s, *value);
+		s += 8;
 	}
 
 	void container::push_back(char value) {
+		check_expand();
 		data[s] = value;
 		s++;
-		check_expand();
 	}
 
 	void container::push_back(const char* src, uint32_t len) {
 		check_resize(len);
-		for (uint32_t i = 0; i < len; i++) {
-			data[s + i] = src[i];
-		}
+		memcpy(data + s, src, len);
 		s += len;
 	}
 
 	void container::push_back(char* src, uint32_t len) {
 		check_resize(len);
-		for (uint32_t i = 0; i < len; i++) {
-			data[s + i] = src[i];
-		}
+		memcpy(data + s, src, len);
 		s += len;
 	}
 
@@ -199,30 +186,21 @@ namespace msgpack_byte {
 			len = src.length();
 		}
 		check_resize(len);
-		for (uint32_t i = 0; i < len; i++) {
-			data[s + i] = src[i];
-		}
+		memcpy(data + s, src.data(), len);
 		s += len;
 	}
 
 	// reading
 
+	// unchecked like the reads below, msgpack::validate proves the bounds once before decoding
 	uint8_t container::get_header(uint64_t& pos) {
-		Iterator it = Iterator(data + pos);
-		if (it != end()) {
-			return data[pos++];
-		}
-		else {
-			throw std::out_of_range("out of range!");
-		}
+		return data[pos++];
 	}
 	uint8_t container::read_byte(uint64_t& pos) {
 		return data[pos++];
 	}
 	uint16_t container::read_word(uint64_t& pos) {
-		uint16_t output = 0;
-		*((uint8_t*)(&output)) = data[pos + 1];
-		*((uint8_t*)(&output) + 1) = data[pos];
+		uint16_t output = msgpack_byte::read_word(data + pos);
 		pos += 2;
 		return output;
 	}
@@ -243,67 +221,166 @@ namespace msgpack_byte {
 	}
 
 	void container::resize(size_t reserve) {
-		c = (c + reserve) + 1;
-		uint8_t* temp_arr = new uint8_t[c];
-		std::copy(data, data + s, temp_arr);
-		delete[] data;
-		data = temp_arr;
+		reallocate((c + reserve) + 1);
 	}
 
 	bool container::shrink_to_fit(bool lenient) {
+		if (foreign) {
+			return false; // borrowed bytes are not ours to trim
+		}
 		if (lenient && s != c - 1 && c > lenient_size && c - lenient_size > s) {
-			c = s + 1;
-			uint8_t* temp_arr = new uint8_t[c];
-			std::copy(data, data + s, temp_arr);
-			delete[] data;
-			data = temp_arr;
+			reallocate(s + 1);
 			return true;
 		}
 		else if (!lenient) {
-			c = s + 1;
-			uint8_t* temp_arr = new uint8_t[c];
-			std::copy(data, data + s, temp_arr);
-			delete[] data;
-			data = temp_arr;
+			reallocate(s + 1);
 			return true;
 		}
 		return false;
 	}
 
-	uint8_t* container::raw_pointer() {
+	bool container::borrowed() const {
+		return foreign;
+	}
+
+	const uint8_t* container::raw_pointer() const {
 		return data;
 	}
 
-	uint8_t* container::raw_pointer(uint64_t pos) {
+	const uint8_t* container::raw_pointer(uint64_t pos) const {
+		return data + pos;
+	}
+
+	uint8_t* container::mutable_pointer(uint64_t pos) {
+		if (foreign) {
+			reallocate(c);
+		}
+		drop_validated(pos);
 		return data + pos;
 	}
 
+	void container::commit(size_t bytes) {
+		if (s + bytes >= c) {
+			throw std::out_of_range(std::to_string(s + bytes) + " out of range!");
+		}
+		s += bytes;
+	}
+
+	void container::consume(size_t bytes) {
+		bytes = std::min(bytes, s);
+		if (foreign) {
+			// borrowed bytes can not be moved, the window slides forward instead
+			data += bytes;
+			c -= bytes;
+		}
+		else {
+			memmove(data, data + bytes, s - bytes);
+		}
+		s -= bytes;
+		valid_from = valid_from > bytes ? valid_from - bytes : 0;
+		valid = valid > bytes ? valid - bytes : 0;
+	}
+
+	bool container::validated(uint64_t pos) const {
+		return pos >= valid_from && pos < valid;
+	}
+
+	size_t container::validated_begin() const {
+		return valid_from;
+	}
+
+	size_t container::validated_end() const {
+		return valid;
+	}
+
+	void container::mark_validated(size_t bytes) {
+		valid_from = 0;
+		valid = std::min(bytes, s);
+	}
+
+	void container::mark_validated(size_t begin, size_t end) {
+		end = std::min(end, s);
+		if (begin >= end) {
+			return;
+		}
+		if (begin <= valid && end >= valid_from && valid > valid_from) {
+			valid_from = std::min(valid_from, begin);
+			valid = std::max(valid, end);
+		}
+		else {
+			// a single range is kept, the latest one is where decoding goes on
+			valid_from = begin;
+			valid = end;
+		}
+	}
+
 	// internal
 
-	void container::check_expand() {
-		if (s == c) {
+	// capacity after one growth step
+	static size_t grown(size_t c) {
 #ifdef doubling_strategy
-			c = c * 2;
+		return c * 2;
 #else
-			c = size_t(c * 1.1);
+		return size_t(c * 1.1);
 #endif
-			uint8_t* temp_arr = new uint8_t[c];
-			std::copy(data, data + s, temp_arr);
-			delete[] data;
-			data = temp_arr;
+	}
+
+	void container::check_expand() {
+		if (s >= c) {
+			msgpack_count_growth(grown(c) >= s + 1);
+			reallocate(std::max(grown(c), s + 1));
 		}
 	}
 
 	void container::clear_resize(size_t reserve) {
 		s = 0;
-		c = reserve + 1;
-		delete[] data;
-		data = new uint8_t[c];
+		valid_from = 0;
+		valid = 0;
+		reallocate(reserve + 1);
+	}
+
+	// moves the bytes into a new[] buffer, borrowed and adopted buffers become owned ones here (copy on write)
+	void container::reallocate(size_t capacity) {
+#ifdef with_stats
+		stats_detail::scoped_timer timer(stats_detail::growth_ns);
+		stats_detail::add(stats_detail::reallocations);
+		stats_detail::add(stats_detail::bytes_copied, std::min(s, capacity));
+		stats_detail::raise(stats_detail::peak_capacity, capacity);
+#endif
+		uint8_t* temp_arr = new uint8_t[capacity];
+		std::copy(data, data + std::min(s, capacity), temp_arr);
+		release();
+		data = temp_arr;
+		c = capacity;
+		foreign = false;
+		deleter = nullptr;
+	}
+
+	void container::release() {
+		if (deleter) {
+			deleter(data);
+		}
+		else if (!foreign) {
+			delete[] data;
+		}
+	}
+
+	// bytes from pos on may change, appending at size() keeps the range
+	void container::drop_validated(size_t pos) {
+		if (pos <= valid_from) {
+			valid_from = 0;
+			valid = 0;
+		}
+		else {
+			valid = std::min(valid, pos);
+		}
 	}
 
 	void container::check_resize(size_t bytes) {
 		if (bytes + s >= c) {
-			resize(bytes - c + s);
+			// at least one growth step, so runs of writes past the pre-sizing estimate stay amortized
+			msgpack_count_growth(grown(c) >= s + bytes + 1);
+			reallocate(std::max(grown(c), s + bytes + 1));
 		}
 	}
 
@@ -2,23 +2,152 @@
 #define CONTAINER_HPP
 
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <iterator>
 #include <cstddef>
 #include <sstream>
 #include <iomanip>
 #include <any>
+#include <functional>
 
 namespace msgpack_byte {
+	// byte order
+
+	inline uint16_t bswap16(uint16_t value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		return value;
+#elif defined(_MSC_VER)
+		return _byteswap_ushort(value);
+#else
+		return __builtin_bswap16(value);
+#endif
+	}
+	inline uint32_t bswap32(uint32_t value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		return value;
+#elif defined(_MSC_VER)
+		return _byteswap_ulong(value);
+#else
+		return __builtin_bswap32(value);
+#endif
+	}
+	inline uint64_t bswap64(uint64_t value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		return value;
+#elif defined(_MSC_VER)
+		return _byteswap_uint64(value);
+#else
+		return __builtin_bswap64(value);
+#endif
+	}
+
+	// big endian reads from raw bytes as single unaligned loads, shared by container and msgpack::view
+
+	inline uint16_t read_word(const uint8_t* src) {
+		uint16_t output;
+		memcpy(&output, src, 2);
+		return bswap16(output);
+	}
+	template<typename T = uint32_t>
+	T read_d_word(const uint8_t* src) {
+		static_assert(sizeof(T) == 4);
+		uint32_t bits;
+		memcpy(&bits, src, 4);
+		bits = bswap32(bits);
+		T output;
+		memcpy(&output, &bits, 4);
+		return output;
+	}
+	template<typename T = uint64_t>
+	T read_q_word(const uint8_t* src) {
+		static_assert(sizeof(T) == 8);
+		uint64_t bits;
+		memcpy(&bits, src, 8);
+		bits = bswap64(bits);
+		T output;
+		memcpy(&output, &bits, 8);
+		return output;
+	}
+
+	// big endian writes as single unaligned stores
+
+	inline void store_word(uint8_t* dest, uint16_t value) {
+		value = bswap16(value);
+		memcpy(dest, &value, 2);
+	}
+	inline void store_d_word(uint8_t* dest, uint32_t value) {
+		value = bswap32(value);
+		memcpy(dest, &value, 4);
+	}
+	inline void store_q_word(uint8_t* dest, uint64_t value) {
+		value = bswap64(value);
+		memcpy(dest, &value, 8);
+	}
+	inline void store_d_word(uint8_t* dest, float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, 4);
+		store_d_word(dest, bits);
+	}
+	inline void store_q_word(uint8_t* dest, double value) {
+		uint64_t bits;
+		memcpy(&bits, &value, 8);
+		store_q_word(dest, bits);
+	}
+
+	// little endian element access for raw payloads (typed arrays), plain copies on little endian hosts
+
+	constexpr bool little_endian_host() {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		return false;
+#else
+		return true;
+#endif
+	}
+	template<typename T>
+	T load_little(const uint8_t* src) {
+		T output;
+		if constexpr (little_endian_host()) {
+			memcpy(&output, src, sizeof(T));
+		}
+		else {
+			uint8_t bytes[sizeof(T)];
+			for (size_t i = 0; i < sizeof(T); i++) {
+				bytes[i] = src[sizeof(T) - 1 - i];
+			}
+			memcpy(&output, bytes, sizeof(T));
+		}
+		return output;
+	}
+	template<typename T>
+	void store_little(uint8_t* dest, T value) {
+		memcpy(dest, &value, sizeof(T));
+		if constexpr (!little_endian_host()) {
+			std::reverse(dest, dest + sizeof(T));
+		}
+	}
+
 	class container {
 	public:
 
-		container() : s(0), c(2), data(new uint8_t[2]) {};
-		container(size_t reserve) : s(0), c(reserve + 1), data(new uint8_t[reserve + 1]) {};
+		container() : data(new uint8_t[2]), s(0), c(2) {};
+		container(size_t reserve) : data(new uint8_t[reserve + 1]), s(0), c(reserve + 1) {};
+		// borrowed: reads len bytes owned by someone else (network buffer, mapped file, shared memory) in place, the bytes
+		// are copied into an owned buffer on the first write and must outlive the container until then
+		container(const uint8_t* src, size_t len) : data(const_cast<uint8_t*>(src)), s(len), c(len), foreign(true) {};
+		// adopted: takes over a writable buffer holding size bytes, deleter releases it on destruction or when it
+		// has to grow (the bytes then move to a new[] buffer)
+		container(uint8_t* buffer, size_t size, size_t capacity, std::function<void(uint8_t*)> release) : data(buffer), s(size), c(capacity), deleter(std::move(release)) {};
+		container(const container& other);
+		container(container&& other) noexcept;
+		container& operator=(container other) noexcept;
 		~container();
 
 		// operators
 
-		uint8_t& operator[] (int i);
+		uint8_t& operator[] (int i); // copies borrowed bytes and drops the validation of the bytes from i on, as the byte may be written
+		uint8_t operator[] (int i) const;
 		bool operator==(const container& rhs) const;
 		bool operator!=(const container& rhs) const;
 
@@ -48,15 +177,32 @@ namespace msgpack_byte {
 		size_t capacity() const;
 		void resize(size_t reserve);
 		bool shrink_to_fit(bool lenient = true);
+		bool borrowed() const;
 
-		uint8_t* raw_pointer();
-		uint8_t* raw_pointer(uint64_t pos);
+		const uint8_t* raw_pointer() const;
+		const uint8_t* raw_pointer(uint64_t pos) const;
+		uint8_t* mutable_pointer(uint64_t pos); // for writes in place, copies borrowed bytes and drops the validation of the bytes from pos on
+		void commit(size_t bytes);
+		void consume(size_t bytes); // drops bytes from the front
+
+		// validation, values starting inside the validated range [validated_begin(), validated_end()) are decoded with a
+		// bounds check of their header only, msgpack::validate grows the range over the values it proves well-formed and
+		// mark_validated(size()) declares trusted input well-formed, writes through iterators need mark_validated(0)
+
+		bool validated(uint64_t pos) const;
+		size_t validated_begin() const;
+		size_t validated_end() const;
+		void mark_validated(size_t bytes); // the range becomes [0, bytes)
+		void mark_validated(size_t begin, size_t end); // joins the range when they overlap or touch, replaces it otherwise
 
 		// internal
 
 		void check_expand();
 		void clear_resize(size_t reserve);
 		void check_resize(size_t reserve);
+		void reallocate(size_t capacity);
+		void release();
+		void drop_validated(size_t pos);
 
 		// iterator class
 
@@ -97,25 +243,13 @@ namespace msgpack_byte {
 
 		template<typename T = uint32_t>
 		T read_d_word(uint64_t& pos) {
-			T output;
-			*((uint8_t*)(&output)) = data[pos + 3];
-			*((uint8_t*)(&output) + 1) = data[pos + 2];
-			*((uint8_t*)(&output) + 2) = data[pos + 1];
-			*((uint8_t*)(&output) + 3) = data[pos];
+			T output = msgpack_byte::read_d_word<T>(data + pos);
 			pos += 4;
 			return output;
 		}
 		template<typename T = uint64_t>
 		T read_q_word(uint64_t& pos) {
-			T output;
-			*((uint8_t*)(&output)) = data[pos + 7];
-			*((uint8_t*)(&output) + 1) = data[pos + 6];
-			*((uint8_t*)(&output) + 2) = data[pos + 5];
-			*((uint8_t*)(&output) + 3) = data[pos + 4];
-			*((uint8_t*)(&output) + 4) = data[pos + 3];
-			*((uint8_t*)(&output) + 5) = data[pos + 2];
-			*((uint8_t*)(&output) + 6) = data[pos + 1];
-			*((uint8_t*)(&output) + 7) = data[pos];
+			T output = msgpack_byte::read_q_word<T>(data + pos);
 			pos += 8;
 			return output;
 		}
@@ -125,6 +259,76 @@ namespace msgpack_byte {
 		uint8_t* data;
 		size_t s;
 		size_t c;
+		bool foreign = false; // borrowed bytes, never released by the container
+		size_t valid_from = 0; // bytes [valid_from, valid) proven well-formed
+		size_t valid = 0;
+		std::function<void(uint8_t*)> deleter; // releases adopted buffers, empty for new[] buffers
+	};
+
+	// writes into memory that was already reserved for the whole output, every scalar is a single store and nothing is
+	// bounds checked, so the caller must guarantee the space (eg. container::check_resize(msgpack::packed_size(src)))
+
+	class unchecked_writer {
+	public:
+
+		unchecked_writer(uint8_t* dest) : start(dest), cursor(dest) {};
+
+		// insertion
+
+		void push_back(uint8_t value) {
+			*cursor++ = value;
+		}
+		void push_back(uint16_t value) {
+			store_word(cursor, value);
+			cursor += 2;
+		}
+		void push_back(uint32_t value) {
+			store_d_word(cursor, value);
+			cursor += 4;
+		}
+		void push_back(uint64_t value) {
+			store_q_word(cursor, value);
+			cursor += 8;
+		}
+		void push_back(float value) {
+			store_d_word(cursor, value);
+			cursor += 4;
+		}
+		void push_back(double value) {
+			store_q_word(cursor, value);
+			cursor += 8;
+		}
+		void push_back(char value) {
+			*cursor++ = uint8_t(value);
+		}
+		void push_back(const char* src, uint32_t len) {
+			memcpy(cursor, src, len);
+			cursor += len;
+		}
+		void push_back(char* src, uint32_t len) {
+			memcpy(cursor, src, len);
+			cursor += len;
+		}
+		void push_back(const std::string& src, uint32_t len = 0) {
+			if (len == 0) {
+				len = uint32_t(src.length());
+			}
+			memcpy(cursor, src.data(), len);
+			cursor += len;
+		}
+
+		// utility
+
+		static constexpr bool presizes = false; // the space is reserved up front
+		void check_resize(size_t) { }
+		size_t size() const {
+			return size_t(cursor - start);
+		}
+
+	private:
+
+		uint8_t* start;
+		uint8_t* cursor;
 	};
 
 	template<typename T>
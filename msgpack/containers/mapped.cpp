@@ -0,0 +1,220 @@
+#include <stdexcept>
+#include <cerrno>
+#include <string>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "mapped.hpp"
+
+namespace msgpack_byte {
+	static std::runtime_error mapping_error(const std::string& call) {
+		return std::runtime_error(call + " failed with errno " + std::to_string(errno));
+	}
+
+#ifndef _WIN32
+	static int advice_of(access hint) {
+		switch (hint) {
+		case access::sequential:
+			return MADV_SEQUENTIAL;
+		case access::random:
+			return MADV_RANDOM;
+		case access::willneed:
+			return MADV_WILLNEED;
+		default:
+			return MADV_NORMAL;
+		}
+	}
+
+	// madvise wants a page aligned start
+	static void advise_range(uint8_t* data, size_t size, int advice, size_t offset, size_t len) {
+		if (data == nullptr || offset >= size) {
+			return;
+		}
+		size_t end = (len == 0 || len > size - offset) ? size : offset + len;
+		size_t page = size_t(sysconf(_SC_PAGESIZE));
+		size_t start = offset - offset % page;
+		madvise(data + start, end - start, advice);
+	}
+#endif
+
+	// mapped sink
+
+	mapped_sink::mapped_sink(const std::string& path, size_t reserve) : fd(-1), s(0), c(0), data(nullptr) {
+#ifdef _WIN32
+		throw std::runtime_error("memory mapped files are not supported on this platform!");
+#else
+		fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			throw mapping_error("open " + path);
+		}
+		try {
+			remap(std::max<size_t>(reserve, 1));
+		}
+		catch (...) {
+			::close(fd);
+			throw;
+		}
+#endif
+	}
+
+	mapped_sink::~mapped_sink() {
+		try {
+			close();
+		}
+		catch (...) { }
+	}
+
+	void mapped_sink::write(const uint8_t* src, size_t len) {
+		if (s + len > c) {
+			remap(std::max(c * 2, s + len));
+		}
+		memcpy(data + s, src, len);
+		s += len;
+	}
+
+	void mapped_sink::check_resize(size_t reserve) {
+		if (s + reserve > c) {
+			remap(s + reserve);
+		}
+	}
+
+	size_t mapped_sink::size() const {
+		return s;
+	}
+
+	size_t mapped_sink::capacity() const {
+		return c;
+	}
+
+	uint8_t* mapped_sink::raw_pointer() {
+		return data;
+	}
+
+	container mapped_sink::bytes() {
+		return container(data, s);
+	}
+
+	void mapped_sink::close() {
+#ifndef _WIN32
+		if (fd < 0) {
+			return;
+		}
+		int descriptor = fd;
+		fd = -1;
+		munmap(data, c);
+		data = nullptr;
+		c = 0;
+		int result = ::ftruncate(descriptor, off_t(s));
+		::close(descriptor);
+		if (result != 0) {
+			throw mapping_error("ftruncate");
+		}
+#endif
+	}
+
+	// grows the file first, then the mapping, in place where the kernel can (mremap), otherwise by mapping it again
+	void mapped_sink::remap(size_t capacity) {
+#ifndef _WIN32
+		if (fd < 0) {
+			throw std::runtime_error("mapped sink is closed!");
+		}
+		if (::ftruncate(fd, off_t(capacity)) != 0) {
+			throw mapping_error("ftruncate");
+		}
+		void* mapping;
+		if (data == nullptr) {
+			mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		else {
+#ifdef __linux__
+			mapping = mremap(data, c, capacity, MREMAP_MAYMOVE);
+#else
+			munmap(data, c);
+			data = nullptr;
+			mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+#endif
+		}
+		if (mapping == MAP_FAILED) {
+			throw mapping_error("mmap");
+		}
+		data = static_cast<uint8_t*>(mapping);
+		c = capacity;
+#endif
+	}
+
+	// mapped file
+
+	mapped_file::mapped_file(const std::string& path, access hint) : fd(-1), s(0), data(nullptr) {
+#ifdef _WIN32
+		throw std::runtime_error("memory mapped files are not supported on this platform!");
+#else
+		fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw mapping_error("open " + path);
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			::close(fd);
+			throw mapping_error("fstat " + path);
+		}
+		s = size_t(info.st_size);
+		if (s != 0) { // empty files can not be mapped
+			void* mapping = mmap(nullptr, s, PROT_READ, MAP_SHARED, fd, 0);
+			if (mapping == MAP_FAILED) {
+				::close(fd);
+				throw mapping_error("mmap " + path);
+			}
+			data = static_cast<uint8_t*>(mapping);
+			advise(hint);
+		}
+#endif
+	}
+
+	mapped_file::~mapped_file() {
+		close();
+	}
+
+	size_t mapped_file::size() const {
+		return s;
+	}
+
+	const uint8_t* mapped_file::raw_pointer() const {
+		return data;
+	}
+
+	container mapped_file::bytes() const {
+		return container(data, s);
+	}
+
+	void mapped_file::advise(access hint, size_t offset, size_t len) {
+#ifndef _WIN32
+		advise_range(data, s, advice_of(hint), offset, len);
+#endif
+	}
+
+	void mapped_file::discard(size_t offset, size_t len) {
+#ifndef _WIN32
+		advise_range(data, s, MADV_DONTNEED, offset, len);
+#endif
+	}
+
+	void mapped_file::close() {
+#ifndef _WIN32
+		if (data != nullptr) {
+			munmap(data, s);
+			data = nullptr;
+		}
+		if (fd >= 0) {
+			::close(fd);
+			fd = -1;
+		}
+		s = 0;
+#endif
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef MAPPED_HPP
+#define MAPPED_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include "byte.hpp"
+#include "sink.hpp"
+
+namespace msgpack_byte {
+	// memory mapped files (POSIX), data larger than memory headroom is packed and unpacked through the page cache
+	// instead of a heap buffer, constructors throw std::runtime_error on other platforms
+
+	// access pattern hints passed to madvise
+
+	enum class access {
+		normal,
+		sequential, // read ahead aggressively, pages behind the cursor are reclaimed first
+		random,     // no read ahead
+		willneed    // start paging the range in now
+	};
+
+	// packs straight into a file: the mapping grows with ftruncate and mremap (no copy of what was already written),
+	// and close() trims the file to the bytes written
+
+	class mapped_sink : public sink<mapped_sink> {
+	public:
+
+		mapped_sink(const std::string& path, size_t reserve = 0x100000);
+		mapped_sink(const mapped_sink&) = delete;
+		mapped_sink& operator=(const mapped_sink&) = delete;
+		~mapped_sink();
+
+		void write(const uint8_t* src, size_t len);
+
+		// utility
+
+		static constexpr bool presizes = true;
+		void check_resize(size_t reserve); // grows the file once for reserve more bytes
+		size_t size() const;
+		size_t capacity() const;
+		uint8_t* raw_pointer();
+		container bytes(); // borrowed, valid until the next write or close()
+		void close();
+
+	private:
+
+		void remap(size_t capacity);
+
+		int fd;
+		size_t s;
+		size_t c;
+		uint8_t* data;
+	};
+
+	// maps an existing file read-only, bytes() is a borrowed container so every unpack overload, msgpack::view and
+	// the indexes read the file in place
+
+	class mapped_file {
+	public:
+
+		mapped_file(const std::string& path, access hint = access::sequential);
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+		~mapped_file();
+
+		// utility
+
+		size_t size() const;
+		const uint8_t* raw_pointer() const;
+		container bytes() const;
+		void advise(access hint, size_t offset = 0, size_t len = 0); // len 0 means up to the end
+		void discard(size_t offset, size_t len); // drops already decoded pages from the page cache early
+		void close();
+
+	private:
+
+		int fd;
+		size_t s;
+		uint8_t* data;
+	};
+};
+
+#endif
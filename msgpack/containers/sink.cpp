@@ -0,0 +1,78 @@
+#include <stdexcept>
+#include <cerrno>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "sink.hpp"
+
+namespace msgpack_byte {
+	// span sink
+
+	void span_sink::write(const uint8_t* src, size_t len) {
+		if (s + len > c) {
+			throw std::out_of_range(std::to_string(s + len) + " out of range!");
+		}
+		memcpy(data + s, src, len);
+		s += len;
+	}
+
+	size_t span_sink::size() const {
+		return s;
+	}
+
+	size_t span_sink::capacity() const {
+		return c;
+	}
+
+	uint8_t* span_sink::raw_pointer() {
+		return data;
+	}
+
+	// ostream sink
+
+	ostream_sink::~ostream_sink() {
+		try {
+			flush();
+		}
+		catch (...) { }
+	}
+
+	void ostream_sink::drain(const uint8_t* src, size_t len) {
+		out.write(reinterpret_cast<const char*>(src), std::streamsize(len));
+		if (!out) {
+			throw std::runtime_error("ostream write failed!");
+		}
+	}
+
+	// fd sink
+
+	fd_sink::~fd_sink() {
+		try {
+			flush();
+		}
+		catch (...) { }
+	}
+
+	void fd_sink::drain(const uint8_t* src, size_t len) {
+		while (len > 0) {
+#ifdef _WIN32
+			int written = _write(fd, src, unsigned(len > 0x40000000 ? 0x40000000 : len));
+#else
+			ssize_t written = ::write(fd, src, len);
+#endif
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw std::runtime_error("fd write failed with errno " + std::to_string(errno));
+			}
+			src += written;
+			len -= size_t(written);
+		}
+	}
+}
@@ -0,0 +1,168 @@
+#ifndef SINK_HPP
+#define SINK_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <ostream>
+
+#include "byte.hpp"
+
+namespace msgpack_byte {
+	// output sinks accept the same push_back interface as container, so every msgpack::pack overload can write to them
+
+	template<typename Derived>
+	class sink {
+	public:
+
+		// insertion
+
+		void push_back(uint8_t value) {
+			emit(&value, 1);
+		}
+		void push_back(uint16_t value) {
+			uint8_t bytes[2];
+			store_word(bytes, value);
+			emit(bytes, 2);
+		}
+		void push_back(uint32_t value) {
+			uint8_t bytes[4];
+			store_d_word(bytes, value);
+			emit(bytes, 4);
+		}
+		void push_back(uint64_t value) {
+			uint8_t bytes[8];
+			store_q_word(bytes, value);
+			emit(bytes, 8);
+		}
+		void push_back(float value) {
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			push_back(bits);
+		}
+		void push_back(double value) {
+			uint64_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			push_back(bits);
+		}
+		void push_back(char value) {
+			emit(reinterpret_cast<const uint8_t*>(&value), 1);
+		}
+		void push_back(const char* src, uint32_t len) {
+			emit(reinterpret_cast<const uint8_t*>(src), len);
+		}
+		void push_back(char* src, uint32_t len) {
+			emit(reinterpret_cast<const uint8_t*>(src), len);
+		}
+		void push_back(const std::string& src, uint32_t len = 0) {
+			if (len == 0) {
+				len = uint32_t(src.length());
+			}
+			emit(reinterpret_cast<const uint8_t*>(src.data()), len);
+		}
+
+		// utility
+
+		static constexpr bool presizes = false;
+		void check_resize(size_t) { } // sinks do not pre-size
+
+	private:
+
+		void emit(const uint8_t* src, size_t len) {
+			static_cast<Derived*>(this)->write(src, len);
+		}
+	};
+
+	// writes into a caller-provided buffer, throws once the buffer is full
+
+	class span_sink : public sink<span_sink> {
+	public:
+
+		span_sink(uint8_t* buffer, size_t len) : s(0), c(len), data(buffer) {};
+
+		void write(const uint8_t* src, size_t len);
+
+		size_t size() const;
+		size_t capacity() const;
+		uint8_t* raw_pointer();
+
+	private:
+
+		size_t s;
+		size_t c;
+		uint8_t* data;
+	};
+
+	// collects writes in a fixed staging buffer and hands full buffers to Derived::drain
+
+	template<typename Derived>
+	class staged_sink : public sink<Derived> {
+	public:
+
+		staged_sink(size_t staging) : s(0), c(staging), data(new uint8_t[staging]) {};
+
+		void write(const uint8_t* src, size_t len) {
+			if (s + len > c) {
+				flush();
+				if (len >= c) {
+					static_cast<Derived*>(this)->drain(src, len);
+					return;
+				}
+			}
+			memcpy(data.get() + s, src, len);
+			s += len;
+		}
+
+		void flush() {
+			if (s != 0) {
+				size_t n = s;
+				s = 0;
+				static_cast<Derived*>(this)->drain(data.get(), n);
+			}
+		}
+
+		size_t staged() const {
+			return s;
+		}
+
+	private:
+
+		size_t s;
+		size_t c;
+		std::unique_ptr<uint8_t[]> data;
+	};
+
+	// std::ostream, flushed on destruction or explicitly with flush()
+
+	class ostream_sink : public staged_sink<ostream_sink> {
+	public:
+
+		ostream_sink(std::ostream& stream, size_t staging = 0x10000) : staged_sink(staging), out(stream) {};
+		~ostream_sink();
+
+		void drain(const uint8_t* src, size_t len);
+
+	private:
+
+		std::ostream& out;
+	};
+
+	// POSIX file descriptor (not closed by the sink), flushed on destruction or explicitly with flush()
+
+	class fd_sink : public staged_sink<fd_sink> {
+	public:
+
+		fd_sink(int descriptor, size_t staging = 0x10000) : staged_sink(staging), fd(descriptor) {};
+		~fd_sink();
+
+		void drain(const uint8_t* src, size_t len);
+
+	private:
+
+		int fd;
+	};
+};
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include "../formats.hpp"
+
+// hot path instrumentation, compiled in with #define with_stats, the hooks below expand to nothing otherwise and their
+// arguments are never evaluated
+#ifdef with_stats
+#define msgpack_count_encode(header) msgpack_byte::stats_detail::add(msgpack_byte::stats_detail::encoded + msgpack_byte::format_family(uint8_t(header)))
+#define msgpack_count_decode(header) msgpack_byte::stats_detail::add(msgpack_byte::stats_detail::decoded + msgpack_byte::format_family(uint8_t(header)))
+#define msgpack_count_growth(policy) msgpack_byte::stats_detail::add((policy) ? msgpack_byte::stats_detail::policy_growths : msgpack_byte::stats_detail::exact_growths)
+#define msgpack_timed_sizing(expr) msgpack_byte::stats_detail::timed(msgpack_byte::stats_detail::sizing_ns, [&] { return (expr); })
+#else
+#define msgpack_count_encode(header) ((void)0)
+#define msgpack_count_decode(header) ((void)0)
+#define msgpack_count_growth(policy) ((void)0)
+#define msgpack_timed_sizing(expr) (expr)
+#endif
+
+namespace msgpack_byte {
+	// format families: the five fix ranges, then one per header byte from nil (0xc0) to map32 (0xdf)
+
+	constexpr size_t format_families = 37;
+
+	constexpr size_t format_family(uint8_t header) {
+		return header <= posmax8 ? 0 : header < fixarray ? 1 : header < fixstr ? 2 : header < nil ? 3 : header >= neg32 ? 4 : size_t(5 + header - nil);
+	}
+
+	inline const char* format_family_name(size_t family) {
+		static const char* const names[format_families] = {
+			"positive fixint", "fixmap", "fixarray", "fixstr", "negative fixint",
+			"nil", "never used", "false", "true", "bin8", "bin16", "bin32", "ext8", "ext16", "ext32", "float32", "float64",
+			"uint8", "uint16", "uint32", "uint64", "int8", "int16", "int32", "int64",
+			"fixext1", "fixext2", "fixext4", "fixext8", "fixext16", "str8", "str16", "str32", "array16", "array32", "map16", "map32"
+		};
+		return family < format_families ? names[family] : "";
+	}
+
+	namespace stats_detail {
+		// counter slots, the families follow the scalar counters
+		enum slot : size_t {
+			reallocations,
+			bytes_copied,
+			peak_capacity,
+			growth_ns,
+			policy_growths,
+			exact_growths,
+			sizing_ns,
+			encoded,
+			decoded = encoded + format_families,
+			slots = decoded + format_families
+		};
+
+		// counters of one thread, only that thread writes them so increments are a plain load and store
+		struct block {
+			std::atomic<uint64_t> counters[slots];
+
+			block() {
+				for (auto& c : counters) {
+					c.store(0, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		struct registry {
+			std::mutex lock;
+			std::vector<block*> live;
+			uint64_t retired[slots] = {}; // folded in from threads that exited
+			uint64_t baseline[slots] = {}; // totals at the last reset
+		};
+
+		inline registry& threads() {
+			static registry r;
+			return r;
+		}
+
+		struct owner {
+			block counters;
+
+			owner() {
+				registry& r = threads();
+				std::lock_guard<std::mutex> guard(r.lock);
+				r.live.push_back(&counters);
+			}
+			~owner() {
+				registry& r = threads();
+				std::lock_guard<std::mutex> guard(r.lock);
+				for (size_t i = 0; i < slots; i++) {
+					uint64_t value = counters.counters[i].load(std::memory_order_relaxed);
+					r.retired[i] = i == peak_capacity ? std::max(r.retired[i], value) : r.retired[i] + value;
+				}
+				r.live.erase(std::find(r.live.begin(), r.live.end(), &counters));
+			}
+		};
+
+		inline block& local() {
+			static thread_local owner o;
+			return o.counters;
+		}
+
+		inline void add(size_t slot, uint64_t n = 1) {
+			std::atomic<uint64_t>& c = local().counters[slot];
+			c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+
+		inline void raise(size_t slot, uint64_t value) {
+			std::atomic<uint64_t>& c = local().counters[slot];
+			if (value > c.load(std::memory_order_relaxed)) {
+				c.store(value, std::memory_order_relaxed);
+			}
+		}
+
+		// adds the nanoseconds until it goes out of scope to slot
+		struct scoped_timer {
+			size_t slot;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			scoped_timer(size_t slot) : slot(slot) {};
+			~scoped_timer() {
+				add(slot, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+			}
+		};
+
+		template<typename F>
+		auto timed(size_t slot, F&& f) {
+			scoped_timer timer(slot);
+			return f();
+		}
+	};
+
+	// totals of the instrumentation counters over all threads since the last reset, all zero unless built with_stats
+	struct stats {
+		static constexpr bool enabled =
+#ifdef with_stats
+			true;
+#else
+			false;
+#endif
+
+		// container growth
+		uint64_t reallocations = 0; // buffers moved by container::reallocate (growth, shrink_to_fit, copy on write)
+		uint64_t bytes_copied = 0; // bytes copied while moving them
+		uint64_t peak_capacity = 0; // largest capacity reallocated to
+		uint64_t growth_ns = 0; // time spent reallocating
+		uint64_t policy_growths = 0; // writes past the capacity grown by one growth step (1.1x, or doubling_strategy)
+		uint64_t exact_growths = 0; // grown to exactly the bytes asked for, eg. pre-sizing with LengthOf or large writes
+
+		// packing
+		uint64_t sizing_ns = 0; // time spent estimating the packed size (LengthOf, packed_size) before packing
+
+		// headers written and read per format family, see format_family_name
+		uint64_t encoded[format_families] = {};
+		uint64_t decoded[format_families] = {};
+
+		static stats snapshot() {
+			stats result;
+#ifdef with_stats
+			stats_detail::registry& r = stats_detail::threads();
+			std::lock_guard<std::mutex> guard(r.lock);
+			uint64_t totals[stats_detail::slots];
+			for (size_t i = 0; i < stats_detail::slots; i++) {
+				totals[i] = r.retired[i];
+				for (stats_detail::block* b : r.live) {
+					uint64_t value = b->counters[i].load(std::memory_order_relaxed);
+					totals[i] = i == stats_detail::peak_capacity ? std::max(totals[i], value) : totals[i] + value;
+				}
+				if (i != stats_detail::peak_capacity) {
+					totals[i] -= r.baseline[i];
+				}
+			}
+			result.reallocations = totals[stats_detail::reallocations];
+			result.bytes_copied = totals[stats_detail::bytes_copied];
+			result.peak_capacity = totals[stats_detail::peak_capacity];
+			result.growth_ns = totals[stats_detail::growth_ns];
+			result.policy_growths = totals[stats_detail::policy_growths];
+			result.exact_growths = totals[stats_detail::exact_growths];
+			result.sizing_ns = totals[stats_detail::sizing_ns];
+			std::copy(totals + stats_detail::encoded, totals + stats_detail::encoded + format_families, result.encoded);
+			std::copy(totals + stats_detail::decoded, totals + stats_detail::decoded + format_families, result.decoded);
+#endif
+			return result;
+		}
+
+		// counting restarts from zero, other threads keep counting meanwhile
+		static void reset() {
+#ifdef with_stats
+			stats_detail::registry& r = stats_detail::threads();
+			std::lock_guard<std::mutex> guard(r.lock);
+			r.retired[stats_detail::peak_capacity] = 0;
+			for (stats_detail::block* b : r.live) {
+				b->counters[stats_detail::peak_capacity].store(0, std::memory_order_relaxed);
+			}
+			for (size_t i = 0; i < stats_detail::slots; i++) {
+				uint64_t total = r.retired[i];
+				for (stats_detail::block* b : r.live) {
+					total += b->counters[i].load(std::memory_order_relaxed);
+				}
+				r.baseline[i] = total;
+			}
+#endif
+		}
+	};
+};
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef FORMATS_HPP
+#define FORMATS_HPP
+
 #include <cstdint>
 
 #define umax8 0xFF
@@ -57,6 +60,8 @@
 #define map32 0xDF
 #define fixint 0xFF
 
+#define typed_array_ext 0x54 // application ext type of typed arrays
+
 static inline uint8_t ufixint_t(uint8_t n) {
 	return uint8_t(n);
 }
@@ -83,4 +88,6 @@ static inline uint8_t fixstr_len(uint8_t n) {
 
 static inline bool is_array(uint8_t) {
 	return 0;
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
@@ -2,8 +2,11 @@
 #define MSGPACK_HPP
 
 #include <type_traits>
+#include <algorithm>
 #include <iostream>
+#include <cstring>
 #include <numeric>
+#include <stdexcept>
 #include <vector>
 #include <queue>
 #include <deque>
@@ -11,27 +14,68 @@
 #include <list>
 #include <string>
 #include <map>
+#include <array>
+#include <atomic>
+#include <string_view>
 
 #include "containers/byte.hpp"
+#include "containers/sink.hpp"
+#include "containers/stats.hpp"
 #include "formats.hpp"
+#include "simd.hpp"
+
+// deepest nesting of arrays and maps msgpack::parse and msgpack::validate accept, their stacks live in fixed arrays
+#ifndef parse_depth
+#define parse_depth 0x200
+#endif
+
+// declares the fields of a user defined structure inside its body, msgpack_define packs them as an array in declaration
+// order, msgpack_define_map as a map keyed by the field names
+#define msgpack_reflect(as_map, ...) \
+	auto msgpack_fields() { return std::tie(__VA_ARGS__); } \
+	auto msgpack_fields() const { return std::tie(__VA_ARGS__); } \
+	static constexpr bool msgpack_as_map = as_map; \
+	static constexpr std::string_view msgpack_names = #__VA_ARGS__;
+#define msgpack_define(...) msgpack_reflect(false, __VA_ARGS__)
+#define msgpack_define_map(...) msgpack_reflect(true, __VA_ARGS__)
 
 namespace msgpack {
 	// some definitions
 
 	using namespace msgpack_byte;
 
+	// structures registered with msgpack_define / msgpack_define_map
+	template<typename T, typename = void>
+	struct reflected : std::false_type {};
 	template<typename T>
-	void pack(std::vector<T>& src, container& dest, bool initial = true);
-	template<typename ...T>
-	void pack(std::tuple<T...>& src, container& dest, bool initial = true);
-	template<typename T, typename S>
-	void pack(std::map<T, S>& src, container& dest, bool initial = true);
-	template<typename T>
-	void pack(std::list<T>& src, container& dest, bool initial = true);
-	template<typename T>
-	void pack(std::queue<T>& src, container& dest, bool initial = true);
+	struct reflected<T, std::void_t<decltype(std::declval<T&>().msgpack_fields())>> : std::true_type {};
+
+	// whether check_resize of a sink reserves anything, sinks that ignore it declare static constexpr bool presizes = false
+	// so the size estimate in front of packing is never computed for them
+	template<typename Sink, typename = void>
+	struct presizes : std::true_type {};
+	template<typename Sink>
+	struct presizes<Sink, std::void_t<decltype(Sink::presizes)>> : std::bool_constant<Sink::presizes> {};
+
 	template<typename T>
-	void pack(std::deque<T>& src, container& dest, bool initial = true);
+	struct is_tuple : std::false_type {};
+	template<typename ...T>
+	struct is_tuple<std::tuple<T...>> : std::true_type {};
+
+	template<typename T, typename Sink>
+	void pack(std::vector<T>& src, Sink& dest, bool initial = true);
+	template<typename ...T, typename Sink>
+	void pack(std::tuple<T...>& src, Sink& dest, bool initial = true);
+	template<typename T, typename S, typename Sink>
+	void pack(std::map<T, S>& src, Sink& dest, bool initial = true);
+	template<typename T, typename Sink>
+	void pack(std::list<T>& src, Sink& dest, bool initial = true);
+	template<typename T, typename Sink>
+	void pack(std::queue<T>& src, Sink& dest, bool initial = true);
+	template<typename T, typename Sink>
+	void pack(std::deque<T>& src, Sink& dest, bool initial = true);
+	template<typename T, typename Sink>
+	std::enable_if_t<reflected<T>::value> pack(T& src, Sink& dest, bool initial = true);
 
 	template<typename T>
 	void unpack(std::vector<T>& dest, container& src);
@@ -58,6 +102,10 @@ namespace msgpack {
 	void unpack(std::queue<T>& dest, container& src, uint64_t& pos);
 	template<typename T>
 	void unpack(std::deque<T>& dest, container& src, uint64_t& pos);
+	template<typename T>
+	std::enable_if_t<reflected<T>::value> unpack(T& dest, container& src, uint64_t& pos);
+	template<typename T>
+	std::enable_if_t<reflected<T>::value> unpack(T& dest, container& src);
 
 	template <typename Tup>
 	size_t iterate_tuple_types_2(const Tup& t);
@@ -78,91 +126,516 @@ namespace msgpack {
 	template <typename T>
 	size_t LengthOf(const T&);
 
+	template<typename T>
+	size_t packed_size(const std::vector<T>& src);
+	template<typename ...T>
+	size_t packed_size(const std::tuple<T...>& src);
+	template<typename T, typename S>
+	size_t packed_size(const std::map<T, S>& src);
+	template<typename T>
+	size_t packed_size(const std::list<T>& src);
+	template<typename T>
+	size_t packed_size(const std::queue<T>& src);
+	template<typename T>
+	size_t packed_size(const std::deque<T>& src);
+	size_t packed_size(const std::string& src);
+	size_t packed_size(std::string_view src);
+	class bin_view;
+	size_t packed_size(const bin_view& src);
+	template<typename T>
+	size_t packed_size(const T& src);
+	void require_valid(container& src, uint64_t pos);
+
 	// utility
 
+	// std::queue keeps its container protected, this exposes it for iteration without popping
+	template<typename T>
+	const typename std::queue<T>::container_type& queue_container(const std::queue<T>& q) {
+		struct access : std::queue<T> {
+			static const typename std::queue<T>::container_type& get(const std::queue<T>& q) {
+				return q.*&access::c;
+			}
+		};
+		return access::get(q);
+	}
+	template<typename T>
+	typename std::queue<T>::container_type& queue_container(std::queue<T>& q) {
+		struct access : std::queue<T> {
+			static typename std::queue<T>::container_type& get(std::queue<T>& q) {
+				return q.*&access::c;
+			}
+		};
+		return access::get(q);
+	}
+
+	// headers
+
+	// what a header introduces
+	enum class kind : uint8_t {
+		null,
+		boolean,
+		uint,
+		sint,
+		f32,
+		f64,
+		str,
+		bin,
+		array,
+		map,
+		ext
+	};
+
+	// the single description of the 256 header bytes that skip_header, validate, element_size, view and parse decode with:
+	// the kind, the bytes of the length field or integer behind the header byte, and the count / payload length / value
+	// of the headers that hold it themselves
+	struct header_formats {
+		struct format {
+			kind k = kind::null;
+			uint8_t width = 0;
+			uint8_t n = 0;
+			bool valid = true;
+		};
+
+		format at[256] = {};
+
+		constexpr header_formats() {
+			for (int header = 0; header < 256; header++) {
+				format& f = at[header];
+				if (header <= posmax8) {
+					f = { kind::uint, 0, uint8_t(header) };
+				}
+				else if (header < fixarray) {
+					f = { kind::map, 0, uint8_t(header - fixmap) };
+				}
+				else if (header < fixstr) {
+					f = { kind::array, 0, uint8_t(header - fixarray) };
+				}
+				else if (header <= fixstr_end) {
+					f = { kind::str, 0, uint8_t(header - fixstr) };
+				}
+				else if (header >= neg32) {
+					f = { kind::sint, 0, uint8_t(header) };
+				}
+				else if (header == flse || header == tru) {
+					f = { kind::boolean, 0, uint8_t(header == tru) };
+				}
+				else if (header >= uint8 && header <= uint64) {
+					f = { kind::uint, uint8_t(1 << (header - uint8)) };
+				}
+				else if (header >= int8 && header <= int64) {
+					f = { kind::sint, uint8_t(1 << (header - int8)) };
+				}
+				else if (header == float32 || header == float64) {
+					f = { header == float32 ? kind::f32 : kind::f64, 0, uint8_t(header == float32 ? 4 : 8) };
+				}
+				else if (header >= fixext1 && header <= fixext16) {
+					f = { kind::ext, 0, uint8_t(1 + (1 << (header - fixext1))) };
+				}
+				else if (header >= str8 && header <= str32) {
+					f = { kind::str, uint8_t(1 << (header - str8)) };
+				}
+				else if (header >= bin8 && header <= bin32) {
+					f = { kind::bin, uint8_t(1 << (header - bin8)) };
+				}
+				else if (header >= ext8 && header <= ext32) {
+					f = { kind::ext, uint8_t(1 << (header - ext8)) };
+				}
+				else if (header == arr16 || header == arr32) {
+					f = { kind::array, uint8_t(header == arr16 ? 2 : 4) };
+				}
+				else if (header == map16 || header == map32) {
+					f = { kind::map, uint8_t(header == map16 ? 2 : 4) };
+				}
+				else if (header != nil) {
+					f.valid = false; // 0xc1, never used
+				}
+			}
+		}
+	};
+
+	constexpr header_formats header_format_table;
+
+	// decoded header: kind, header bytes (the payload follows) and the count / payload length / integer value, for ext
+	// the payload is the type byte and the data
+	struct header_info {
+		kind k;
+		uint8_t len;
+		uint64_t n;
+
+		// bytes behind the header: str, bin and ext payloads, float bits
+		uint64_t payload() const {
+			return k == kind::str || k == kind::bin || k == kind::ext || k == kind::f32 || k == kind::f64 ? n : 0;
+		}
+		// values nested in an array or map, keys and values for maps
+		uint64_t elements() const {
+			return k == kind::array ? n : k == kind::map ? n * 2 : 0;
+		}
+	};
+
+	// decodes the header at pos, returns false when the header byte or the field behind it is not within len (the payload
+	// may still end past len), throws std::invalid_argument for the never used header
+	bool decode_header(const uint8_t* data, size_t len, uint64_t pos, header_info& h) {
+		if (pos >= len) {
+			return false;
+		}
+		const header_formats::format& f = header_format_table.at[data[pos]];
+		if (!f.valid) {
+			throw std::invalid_argument("invalid header at " + std::to_string(pos) + "!");
+		}
+		if (f.width > len - pos - 1) {
+			return false;
+		}
+		const uint8_t* field = data + pos + 1;
+		bool sign = f.k == kind::sint;
+		uint64_t n = 0;
+		switch (f.width) {
+		case 0: {
+			n = sign ? uint64_t(int64_t(int8_t(f.n))) : f.n;
+			break;
+		}
+		case 1: {
+			n = sign ? uint64_t(int64_t(int8_t(field[0]))) : field[0];
+			break;
+		}
+		case 2: {
+			n = sign ? uint64_t(int64_t(int16_t(read_word(field)))) : read_word(field);
+			break;
+		}
+		case 4: {
+			n = sign ? uint64_t(int64_t(read_d_word<int32_t>(field))) : read_d_word(field);
+			break;
+		}
+		default: {
+			n = read_q_word(field);
+			break;
+		}
+		}
+		if (f.k == kind::ext && f.width != 0) {
+			n++; // the type byte
+		}
+		h = { f.k, uint8_t(1 + f.width), n };
+		return true;
+	}
+
+	// decode_header for a value that has to be there: throws std::out_of_range unless the header and its payload end
+	// within len
+	header_info read_header(const uint8_t* data, size_t len, uint64_t pos) {
+		header_info h;
+		if (!decode_header(data, len, pos, h) || h.payload() > len - pos - h.len) {
+			throw std::out_of_range("value at " + std::to_string(pos) + " truncated at " + std::to_string(len) + "!");
+		}
+		return h;
+	}
+
+	// element count of the array or map header at pos (entries for maps), pos is left after the header
 	size_t element_size(container& ele, uint64_t& pos) {
-		uint8_t header = ele[pos];
-		pos++;
-		if (header >= 0 && header <= posmax8) {
+		require_valid(ele, pos);
+		header_info h = read_header(ele.raw_pointer(), ele.size(), pos);
+		msgpack_count_decode(*ele.raw_pointer(pos));
+		if (h.k == kind::null) {
+			pos += h.len;
 			return 0;
 		}
-		else if (header >= fixmap && header < fixarray) {
-			return header - uint8_t(fixmap);
+		if (h.k != kind::array && h.k != kind::map) {
+			throw std::invalid_argument("not an array or map at " + std::to_string(pos) + "!");
+		}
+		pos += h.len;
+		// every element takes at least a byte, a larger count is never reserved for
+		if (h.n > ele.size() - pos) {
+			throw std::out_of_range("element count at " + std::to_string(pos) + " out of range!");
+		}
+		return size_t(h.n);
+	}
+
+	// steps pos over the header at pos and its payload (which may end past len), one pending element is consumed and the
+	// elements an array or map header opens are added, returns false without moving when the header byte or its length
+	// field is not within len yet
+	bool skip_header(const uint8_t* data, size_t len, uint64_t& pos, uint64_t& pending) {
+		header_info h;
+		if (!decode_header(data, len, pos, h)) {
+			return false;
+		}
+		pending = pending - 1 + h.elements();
+		pos += h.len + h.payload();
+		return true;
+	}
+
+#ifdef with_stats
+	// counts the headers of n scalars packed back to back, for the simd kernels that write and read them in bulk
+	void count_headers(const uint8_t* data, size_t n, bool encoding) {
+		uint64_t pos = 0;
+		for (size_t i = 0; i < n; i++) {
+			if (encoding) {
+				msgpack_count_encode(data[pos]);
+			}
+			else {
+				msgpack_count_decode(data[pos]);
+			}
+			uint64_t pending = 1;
+			skip_header(data, SIZE_MAX, pos, pending);
 		}
-		else if (header >= fixarray && header < fixstr) {
-			return header - uint8_t(fixarray);
+	}
+#endif
+
+	// advances pos over one complete value, nested arrays and maps as well as str, bin and ext payloads included
+	void skip(const uint8_t* data, size_t len, uint64_t& pos) {
+		uint64_t pending = 1;
+		while (pending > 0) {
+			if (!skip_header(data, len, pos, pending)) {
+				throw std::out_of_range(std::to_string(pos) + " out of range!");
+			}
 		}
-		else if (header >= fixstr && header < nil) {
-			return header - uint8_t(fixstr);
+		if (pos > len) {
+			throw std::out_of_range(std::to_string(pos) + " out of range!");
 		}
-		switch (header) {
-		case tru:
-		case flse:
-		case nil: {
-			return 0;
+	}
+
+	void skip(container& src, uint64_t& pos) {
+		skip(src.raw_pointer(), src.size(), pos);
+	}
+
+	// validation
+
+	// total size of the values whose header fixes it (fixints, fixstr, nil, bools, numbers, fixext), 0 for the others,
+	// a lookup table over header_format_table for the scalar fast path of validate
+	struct fixed_sizes {
+		uint8_t size[256] = {};
+
+		constexpr fixed_sizes() {
+			for (int header = 0; header < 256; header++) {
+				const header_formats::format& f = header_format_table.at[header];
+				bool payload = f.k == kind::str || f.k == kind::bin || f.k == kind::ext || f.k == kind::f32 || f.k == kind::f64;
+				// arrays, maps and payloads behind a length field are sized by their contents
+				bool sized = f.k != kind::array && f.k != kind::map && !(payload && f.width != 0);
+				if (f.valid && sized) {
+					size[header] = uint8_t(1 + f.width + (payload ? f.n : 0));
+				}
+			}
 		}
-		case int8:
-		case uint8: {
-			pos++;
-			return 1;
+	};
+
+	constexpr fixed_sizes fixed_size_table;
+
+	// proves the value at pos is well-formed in a single pass: known headers, every length within len and nesting at most
+	// max_depth deep (up to parse_depth), pos ends up after it, throws std::out_of_range for truncated or too deep values
+	// and std::invalid_argument for unknown headers
+	void validate(const uint8_t* data, size_t len, uint64_t& pos, size_t max_depth = parse_depth) {
+		uint64_t remaining[parse_depth]; // values left in each open array or map
+		size_t depth = 0;
+		max_depth = std::min(max_depth, size_t(parse_depth));
+		uint64_t at = pos;
+		while (true) {
+			uint8_t fixed = at < len ? fixed_size_table.size[data[at]] : 0;
+			if (fixed != 0) {
+				// scalars take one lookup, runs of them inside an array or map are counted down in a register and eight
+				// positive fixints (high bits clear) are stepped over at once
+				uint64_t left = depth > 0 ? remaining[depth - 1] : 1;
+				while (left > 0 && at < len) {
+					if (left >= 8 && at + 8 <= len) {
+						uint64_t bytes;
+						memcpy(&bytes, data + at, 8);
+						if ((bytes & 0x8080808080808080) == 0) {
+							at += 8;
+							left -= 8;
+							continue;
+						}
+					}
+					fixed = fixed_size_table.size[data[at]];
+					if (fixed == 0) {
+						break;
+					}
+					at += fixed;
+					left--;
+				}
+				if (at > len) {
+					throw std::out_of_range("value at " + std::to_string(pos) + " truncated at " + std::to_string(len) + "!");
+				}
+				if (depth == 0) {
+					break;
+				}
+				remaining[depth - 1] = left + 1; // the last value is completed below
+			}
+			else {
+				uint64_t pending = 1;
+				if (!skip_header(data, len, at, pending) || at > len) {
+					throw std::out_of_range("value at " + std::to_string(pos) + " truncated at " + std::to_string(len) + "!");
+				}
+				if (pending != 0) {
+					// a non empty array or map, pending counts its keys and values
+					if (depth == max_depth) {
+						throw std::out_of_range("nesting deeper than " + std::to_string(max_depth) + "!");
+					}
+					remaining[depth++] = pending;
+					continue;
+				}
+			}
+			while (depth > 0 && --remaining[depth - 1] == 0) {
+				depth--;
+			}
+			if (depth == 0) {
+				break;
+			}
 		}
-		case int16:
-		case uint16: {
-			pos += 2;
-			return 2;
+		pos = at;
+	}
+
+	// validates the value at pos, the validated range of src grows over it when they overlap or touch and moves to it
+	// otherwise, so the values nested in it are not validated again when they are decoded
+	void validate(container& src, uint64_t& pos, size_t max_depth = parse_depth) {
+		uint64_t start = pos;
+		validate(src.raw_pointer(), src.size(), pos, max_depth);
+		src.mark_validated(start, pos);
+	}
+
+	// validates every value of src, a validated range met at a value start is stepped over at once
+	void validate(container& src) {
+		uint64_t pos = 0;
+		while (pos < src.size()) {
+			if (pos == src.validated_begin() && src.validated_end() > pos) {
+				pos = src.validated_end();
+			}
+			else {
+				validate(src, pos);
+			}
 		}
-		case float32:
-		case int32:
-		case uint32: {
-			pos += 4;
-			return 4;
+	}
+
+	// whether the header at pos and its length field, str / bin / ext payload included, end within len
+	bool header_within(const uint8_t* data, size_t len, uint64_t pos) {
+		uint8_t fixed = fixed_size_table.size[data[pos]];
+		if (fixed != 0) {
+			return pos + fixed <= len;
+		}
+		uint64_t pending = 1;
+		return skip_header(data, len, pos, pending) && pos <= len;
+	}
+
+	// decoding reads without bounds checks, a value starting outside the validated range of src is validated first, so
+	// untrusted input is checked once per value, a position inside the range is not necessarily the start of a value
+	// (eg. inside a payload), there its header still has to fit within src which costs one lookup for scalars
+	void require_valid(container& src, uint64_t pos) {
+		if (!src.validated(pos) || !header_within(src.raw_pointer(), src.size(), pos)) {
+			validate(src, pos);
 		}
-		case float64:
-		case int64:
-		case uint64: {
-			pos += 8;
-			return 8;
+	}
+
+	// start offsets of the elements of one packed array or map, element i spans [offsets[i], offsets[i + 1])
+	struct offset_index {
+		std::vector<uint64_t> offsets; // keys and values in turn for maps, the last entry is the end of the whole value
+		bool pairs = false;
+
+		// elements, or entries of a map
+		size_t size() const {
+			size_t n = offsets.empty() ? 0 : offsets.size() - 1;
+			return pairs ? n / 2 : n;
 		}
-		case str8: {
-			return ele.read_byte(pos);
+		// element i, or the key of entry i
+		uint64_t operator[](size_t i) const {
+			return offsets[pairs ? i * 2 : i];
 		}
-		case map16:
-		case arr16:
-		case str16: {
-			return ele.read_word(pos);
+		uint64_t value(size_t i) const {
+			return offsets[i * 2 + 1];
 		}
-		case arr32:
-		case map32:
-		case str32: {
-			return ele.read_d_word(pos);
+		uint64_t end() const {
+			return offsets.back();
 		}
+	};
+
+	// records every element offset of the array or map at pos in one pass, for O(1) access to element i afterwards
+	offset_index build_index(const uint8_t* data, size_t len, uint64_t pos = 0) {
+		header_info h;
+		if (!decode_header(data, len, pos, h)) {
+			throw std::out_of_range(std::to_string(pos) + " out of range!");
+		}
+		if (h.k != kind::array && h.k != kind::map) {
+			throw std::invalid_argument("not an array or map!");
+		}
+		offset_index index;
+		index.pairs = h.k == kind::map;
+		uint64_t n = h.elements();
+		pos += h.len;
+		// every element takes at least one byte, so a corrupt count cannot reserve more than the buffer holds
+		index.offsets.reserve(size_t(std::min<uint64_t>(n, len - pos)) + 1);
+		for (uint64_t i = 0; i < n; i++) {
+			index.offsets.push_back(pos);
+			skip(data, len, pos);
 		}
-		return 0;
+		index.offsets.push_back(pos);
+		return index;
+	}
+
+	offset_index build_index(container& src, uint64_t pos = 0) {
+		return build_index(src.raw_pointer(), src.size(), pos);
 	}
 
+	// borrowed payloads
+
+	// bytes of a bin (or str) payload, the C++17 stand-in for std::span<const std::byte>, decoded views point into the
+	// source container and stay valid while it is neither modified nor destroyed
+	class bin_view {
+	public:
+
+		bin_view() : ptr(nullptr), n(0) {};
+		bin_view(const uint8_t* src, size_t len) : ptr(src), n(len) {};
+
+		const uint8_t& operator[](size_t i) const {
+			return ptr[i];
+		}
+
+		const uint8_t* data() const {
+			return ptr;
+		}
+		size_t size() const {
+			return n;
+		}
+		bool empty() const {
+			return n == 0;
+		}
+		const uint8_t* begin() const {
+			return ptr;
+		}
+		const uint8_t* end() const {
+			return ptr + n;
+		}
+
+	private:
+
+		const uint8_t* ptr;
+		size_t n;
+	};
+
 	// packing functions - primitive
 
-	void pack(const void* src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const void* src, Sink& dest, bool initial = false) {
+		msgpack_count_encode(nil);
 		dest.push_back(uint8_t(nil));
 	}
-	void pack(const char& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const char& src, Sink& dest, bool initial = false) {
+		msgpack_count_encode(single_char);
 		dest.push_back(uint8_t(single_char));
 		dest.push_back(src);
 	}
-	void pack(const char* src, size_t len, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const char* src, size_t len, Sink& dest, bool initial = false) {
 		uint32_t n = static_cast<uint32_t>(len);
 		if (n <= fix32) {
+			msgpack_count_encode(fixstr_t(n));
 			dest.push_back(uint8_t(fixstr_t(n)));
 		}
 		else if (n <= umax8) {
+			msgpack_count_encode(str8);
 			dest.push_back(uint8_t(str8));
 			dest.push_back(uint8_t(n));
 		}
 		else if (n <= umax16) {
+			msgpack_count_encode(str16);
 			dest.push_back(uint8_t(str16));
 			dest.push_back(uint16_t(n));
 		}
 		else if (n <= umax32) {
+			msgpack_count_encode(str32);
 			dest.push_back(uint8_t(str32));
 			dest.push_back(uint32_t(n));
 		}
@@ -171,20 +644,25 @@ namespace msgpack {
 		}
 		dest.push_back(src, n);
 	}
-	void pack(char* src, size_t len, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(char* src, size_t len, Sink& dest, bool initial = false) {
 		uint32_t n = static_cast<uint32_t>(len);
 		if (n <= fix32) {
+			msgpack_count_encode(fixstr_t(n));
 			dest.push_back(uint8_t(fixstr_t(n)));
 		}
 		else if (n <= umax8) {
+			msgpack_count_encode(str8);
 			dest.push_back(uint8_t(str8));
 			dest.push_back(uint8_t(n));
 		}
 		else if (n <= umax16) {
+			msgpack_count_encode(str16);
 			dest.push_back(uint8_t(str16));
 			dest.push_back(uint16_t(n));
 		}
 		else if (n <= umax32) {
+			msgpack_count_encode(str32);
 			dest.push_back(uint8_t(str32));
 			dest.push_back(uint32_t(n));
 		}
@@ -193,20 +671,25 @@ namespace msgpack {
 		}
 		dest.push_back(src, n);
 	}
-	void pack(const std::string& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const std::string& src, Sink& dest, bool initial = false) {
 		uint32_t len = static_cast<uint32_t>(src.length());
 		if (len <= fix32) {
+			msgpack_count_encode(fixstr_t(len));
 			dest.push_back(uint8_t(fixstr_t(len)));
 		}
 		else if (len <= umax8) {
+			msgpack_count_encode(str8);
 			dest.push_back(uint8_t(str8));
 			dest.push_back(uint8_t(len));
 		}
 		else if (len <= umax16) {
+			msgpack_count_encode(str16);
 			dest.push_back(uint8_t(str16));
 			dest.push_back(uint16_t(len));
 		}
 		else if (len <= umax32) {
+			msgpack_count_encode(str32);
 			dest.push_back(uint8_t(str32));
 			dest.push_back(uint32_t(len));
 		}
@@ -215,23 +698,55 @@ namespace msgpack {
 		}
 		dest.push_back(src);
 	}
-	void pack_uint(const uint64_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(std::string_view src, Sink& dest, bool initial = false) {
+		pack(src.data(), src.size(), dest, initial);
+	}
+	template<typename Sink>
+	void pack(const bin_view& src, Sink& dest, bool initial = false) {
+		if (src.size() <= umax8) {
+			msgpack_count_encode(bin8);
+			dest.push_back(uint8_t(bin8));
+			dest.push_back(uint8_t(src.size()));
+		}
+		else if (src.size() <= umax16) {
+			msgpack_count_encode(bin16);
+			dest.push_back(uint8_t(bin16));
+			dest.push_back(uint16_t(src.size()));
+		}
+		else if (src.size() <= umax32) {
+			msgpack_count_encode(bin32);
+			dest.push_back(uint8_t(bin32));
+			dest.push_back(uint32_t(src.size()));
+		}
+		else {
+			throw std::range_error(std::to_string(src.size()) + " out of range!");
+		}
+		dest.push_back(reinterpret_cast<const char*>(src.data()), uint32_t(src.size()));
+	}
+	template<typename Sink>
+	void pack_uint(const uint64_t& src, Sink& dest, bool initial = false) {
 		if (src <= posmax8) {
+			msgpack_count_encode(ufixint_t(src));
 			dest.push_back(uint8_t(ufixint_t(src)));
 		}
 		else if (src <= umax8) {
+			msgpack_count_encode(uint8);
 			dest.push_back(uint8_t(uint8));
 			dest.push_back(uint8_t(src));
 		}
 		else if (src <= umax16) {
+			msgpack_count_encode(uint16);
 			dest.push_back(uint8_t(uint16));
 			dest.push_back(uint16_t(src));
 		}
 		else if (src <= umax32) {
+			msgpack_count_encode(uint32);
 			dest.push_back(uint8_t(uint32));
 			dest.push_back(uint32_t(src));
 		}
 		else if (src <= umax64) {
+			msgpack_count_encode(uint64);
 			dest.push_back(uint8_t(uint64));
 			dest.push_back(uint64_t(src));
 		}
@@ -239,27 +754,34 @@ namespace msgpack {
 			throw std::range_error(std::to_string(src) + " out of range!");
 		}
 	}
-	void pack_int(const int64_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack_int(const int64_t& src, Sink& dest, bool initial = false) {
 		uint64_t a = src;;
 		if (src >= 0 && src <= posmax8) {
+			msgpack_count_encode(src);
 			dest.push_back(uint8_t(src));
 		}
 		else if (src >= int8_t(neg32) && src < 0) {
+			msgpack_count_encode(src);
 			dest.push_back(uint8_t(src));
 		}
 		else if (src >= int8_t(negmax8) && src <= int8_t(posmax8)) {
+			msgpack_count_encode(int8);
 			dest.push_back(uint8_t(int8));
 			dest.push_back(uint8_t(src));
 		}
 		else if (src >= int16_t(negmax16) && src <= int16_t(posmax16)) {
+			msgpack_count_encode(int16);
 			dest.push_back(uint8_t(int16));
 			dest.push_back(uint16_t(src));
 		}
 		else if (src >= int32_t(negmax32) && src <= int32_t(posmax32)) {
+			msgpack_count_encode(int32);
 			dest.push_back(uint8_t(int32));
 			dest.push_back(uint32_t(src));
 		}
 		else if (src >= int64_t(negmax64) && src <= int64_t(posmax64)) {
+			msgpack_count_encode(int64);
 			dest.push_back(uint8_t(int64));
 			dest.push_back(uint64_t(src));
 		}
@@ -267,75 +789,96 @@ namespace msgpack {
 			throw std::range_error(std::to_string(src) + " out of range!");
 		}
 	}
-	void pack(const uint8_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const uint8_t& src, Sink& dest, bool initial = false) {
 		pack_uint(static_cast<uint64_t>(src), dest);
 	}
-	void pack(const uint16_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const uint16_t& src, Sink& dest, bool initial = false) {
 		pack_uint(static_cast<uint64_t>(src), dest);
 	}
-	void pack(const uint32_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const uint32_t& src, Sink& dest, bool initial = false) {
 		pack_uint(static_cast<uint64_t>(src), dest);
 	}
-	void pack(const uint64_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const uint64_t& src, Sink& dest, bool initial = false) {
 		pack_uint(static_cast<uint64_t>(src), dest);
 	}
-	void pack(const int8_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const int8_t& src, Sink& dest, bool initial = false) {
 		pack_int(static_cast<int64_t>(src), dest);
 	}
-	void pack(const int16_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const int16_t& src, Sink& dest, bool initial = false) {
 		pack_int(static_cast<int64_t>(src), dest);
 	}
-	void pack(const int32_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const int32_t& src, Sink& dest, bool initial = false) {
 		pack_int(static_cast<int64_t>(src), dest);
 	}
-	void pack(const int64_t& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const int64_t& src, Sink& dest, bool initial = false) {
 		pack_int(src, dest);
 	}
-	void pack(const double& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const double& src, Sink& dest, bool initial = false) {
 		float src_as_float = float(src);
 		double src_back_to_double = double(src_as_float);
 		if (src_back_to_double == src) {
 			// is float
+			msgpack_count_encode(float32);
 			dest.push_back(uint8_t(float32));
 			dest.push_back(src_as_float);
 		}
 		else {
 			// is double
+			msgpack_count_encode(float64);
 			dest.push_back(uint8_t(float64));
 			dest.push_back(src);
 		}
 	}
-	void pack(const float& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const float& src, Sink& dest, bool initial = false) {
+		msgpack_count_encode(float32);
 		dest.push_back(uint8_t(float32));
 		dest.push_back(src);
 	}
-	void pack(const bool& src, container& dest, bool initial = false) {
+	template<typename Sink>
+	void pack(const bool& src, Sink& dest, bool initial = false) {
 		if (src) {
+			msgpack_count_encode(tru);
 			dest.push_back(uint8_t(tru));
 		}
 		else {
+			msgpack_count_encode(flse);
 			dest.push_back(uint8_t(flse));
 		}
 	}
 
 	// stl iterators
 
-	template<class F, class...Ts, std::size_t...Is>
-	void tuple_iterator_pack(std::tuple<Ts...>& tuple, F func, std::index_sequence<Is...>, container& dest) {
+	template<class F, class D, class...Ts, std::size_t...Is>
+	void tuple_iterator_pack(std::tuple<Ts...>& tuple, F func, std::index_sequence<Is...>, D& dest) {
 		using expander = int[];
 		(void)expander {
 			0, ((void)func(dest, std::get<Is>(tuple)), 0)...
 		};
 	}
 
-	template<class F, class...Ts>
-	void tuple_iterator_pack(std::tuple<Ts...>& tuple, container& dest, F func) {
+	template<class F, class D, class...Ts>
+	void tuple_iterator_pack(std::tuple<Ts...>& tuple, D& dest, F func) {
 		tuple_iterator_pack(tuple, func, std::make_index_sequence<sizeof...(Ts)>(), dest);
 	}
 
 	template <typename T>
-	size_t LengthOf(const T&) {
-		return sizeof(T);
+	size_t LengthOf(const T& s) {
+		if constexpr (reflected<T>::value) {
+			return std::apply([](const auto&... fields) { return (size_t(0) + ... + LengthOf(fields)); }, s.msgpack_fields());
+		}
+		else {
+			return sizeof(T);
+		}
 	}
 
 	template <typename ... Params>
@@ -386,7 +929,7 @@ namespace msgpack {
 		}
 		else {
 			size_t result = 0;
-			for (auto& e : s) {
+			for (auto& e : queue_container(s)) {
 				result += LengthOf(e);
 			}
 			return result;
@@ -425,147 +968,596 @@ namespace msgpack {
 		return std::apply(sum_length, t);
 	}
 
-	// packing functions - STL
+	// typed arrays, an arithmetic vector as one ext record: [ext header][typed_array_ext][element kind][elements, little endian]
+	// peers without the extension skip it like any other ext, and decoding is a single memcpy instead of a header per element
 
-	template <typename T>
-	void pack(std::vector<T>& src, container& dest, bool initial) {
-		size_t n = src.size();
-		if (initial) {
-			dest.check_resize(size_t((LengthOf(src) + 1) * compression_percent));
+	enum class element_kind : uint8_t { u8 = 1, u16, u32, u64, i8, i16, i32, i64, f32, f64 };
+
+	template<typename T>
+	struct typed_element : std::integral_constant<bool, simd::bulk<T>::value && sizeof(T) <= 8> {};
+
+	template<typename T>
+	constexpr element_kind element_kind_of() {
+		static_assert(typed_element<T>::value, "typed arrays hold integers and floating point numbers only");
+		if constexpr (std::is_floating_point<T>::value) {
+			return sizeof(T) == 4 ? element_kind::f32 : element_kind::f64;
 		}
-		if (n <= 15) {
-			dest.push_back(fixarray_t(n));
+		else {
+			// integer kinds are ordered by width from u8 and i8
+			uint8_t width = sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3;
+			return element_kind(uint8_t(std::is_signed<T>::value ? element_kind::i8 : element_kind::u8) + width);
 		}
-		else if (n <= umax16) {
-			dest.push_back(uint8_t(arr16));
-			dest.push_back(uint16_t(n));
+	}
+
+	size_t element_width(element_kind kind) {
+		switch (kind) {
+		case element_kind::u8:
+		case element_kind::i8: {
+			return 1;
 		}
-		else if (n <= umax32) {
-			dest.push_back(uint8_t(arr32));
-			dest.push_back(uint32_t(n));
+		case element_kind::u16:
+		case element_kind::i16: {
+			return 2;
 		}
-		for (uint32_t i = 0; i < n; i++) {
-			pack(src[i], dest, false);
+		case element_kind::u32:
+		case element_kind::i32:
+		case element_kind::f32: {
+			return 4;
 		}
-		if (initial) {
-			// dest.shrink_to_fit();
+		case element_kind::u64:
+		case element_kind::i64:
+		case element_kind::f64: {
+			return 8;
 		}
+		}
+		return 0;
 	}
 
-	template<typename ...T>
-	void pack(std::tuple<T...>& src, container& dest, bool initial) {
-		size_t n = std::tuple_size<typename std::remove_reference<decltype(src)>::type>::value;
-		if (initial) {
-			dest.check_resize(size_t((iterate_tuple_types_2(src) + 1) * compression_percent));
+	// pack(std::vector<T>&) writes typed arrays while this is set and plain arrays otherwise, it starts set when typed_arrays is defined
+	// this is the process wide default, threads that need their own setting use typed_arrays_scope
+	inline std::atomic<bool>& typed_arrays_enabled() {
+#ifdef typed_arrays
+		static std::atomic<bool> enabled(true);
+#else
+		static std::atomic<bool> enabled(false);
+#endif
+		return enabled;
+	}
+
+	namespace typed_detail {
+		inline thread_local int setting = -1; // -1 follows typed_arrays_enabled, otherwise 0 or 1 set by typed_arrays_scope
+	};
+
+	// the setting packing on this thread uses
+	inline bool typed_arrays_on() {
+		int local = typed_detail::setting;
+		return local < 0 ? typed_arrays_enabled().load(std::memory_order_relaxed) : local != 0;
+	}
+
+	// overrides typed_arrays_enabled for the calling thread until it goes out of scope, eg. for a single pack call
+	struct typed_arrays_scope {
+		int previous;
+
+		typed_arrays_scope(bool enabled) : previous(typed_detail::setting) {
+			typed_detail::setting = enabled;
 		}
-		if (n <= 15) {
-			dest.push_back(fixarray_t(n));
+		~typed_arrays_scope() {
+			typed_detail::setting = previous;
 		}
-		else if (n <= umax16) {
-			dest.push_back(uint8_t(arr16));
-			dest.push_back(uint16_t(n));
+		typed_arrays_scope(const typed_arrays_scope&) = delete;
+		typed_arrays_scope& operator=(const typed_arrays_scope&) = delete;
+	};
+
+	size_t packed_size_ext(size_t len) {
+		if (len <= umax8) {
+			return 3 + len;
 		}
-		else if (n <= umax32) {
-			dest.push_back(uint8_t(arr32));
-			dest.push_back(uint32_t(n));
+		else if (len <= umax16) {
+			return 4 + len;
 		}
+		return 6 + len;
+	}
 
-		tuple_iterator_pack(src, dest, [](container& dest, auto& src) { pack(src, dest, false); });
-		if (initial) {
-			// dest.shrink_to_fit();
-		}
+	size_t packed_size_typed(size_t n, size_t width) {
+		return packed_size_ext(1 + n * width);
 	}
 
-	template<typename T, typename S>
-	void pack(std::map<T, S>& src, container& dest, bool initial) {
-		size_t n = src.size();
-		if (initial) {
-			dest.check_resize(size_t((LengthOf(src) + 1) * compression_percent));
+	template<typename T, typename Sink>
+	void pack_typed(const T* src, size_t n, Sink& dest) {
+		size_t len = 1 + n * sizeof(T);
+		if (len <= umax8) {
+			msgpack_count_encode(ext8);
+			dest.push_back(uint8_t(ext8));
+			dest.push_back(uint8_t(len));
 		}
-		if (n <= 15) {
-			dest.push_back(fixmap_t(n));
+		else if (len <= umax16) {
+			msgpack_count_encode(ext16);
+			dest.push_back(uint8_t(ext16));
+			dest.push_back(uint16_t(len));
 		}
-		else if (n <= umax16) {
-			dest.push_back(uint8_t(map16));
-			dest.push_back(uint16_t(n));
+		else if (len <= umax32) {
+			msgpack_count_encode(ext32);
+			dest.push_back(uint8_t(ext32));
+			dest.push_back(uint32_t(len));
 		}
-		else if (n <= umax32) {
-			dest.push_back(uint8_t(map32));
-			dest.push_back(uint32_t(n));
+		else {
+			throw std::range_error(std::to_string(n) + " out of range!");
 		}
-		for (auto& e : src) {
-			pack(e.first, dest, false);
-			pack(e.second, dest, false);
+		dest.push_back(uint8_t(typed_array_ext));
+		dest.push_back(uint8_t(element_kind_of<T>()));
+		if constexpr (little_endian_host()) {
+			if (n != 0) {
+				dest.push_back(reinterpret_cast<const char*>(src), uint32_t(n * sizeof(T)));
+			}
 		}
-		if (initial) {
-			// dest.shrink_to_fit();
+		else {
+			uint8_t bytes[sizeof(T)];
+			for (size_t i = 0; i < n; i++) {
+				store_little(bytes, src[i]);
+				dest.push_back(reinterpret_cast<const char*>(bytes), uint32_t(sizeof(T)));
+			}
 		}
 	}
 
-	template<typename T>
-	void pack(std::list<T>& src, container& dest, bool initial) {
-		size_t n = src.size();
+	template<typename T, typename Sink>
+	void pack_typed(const std::vector<T>& src, Sink& dest, bool initial = true) {
 		if (initial) {
-			dest.check_resize(size_t((LengthOf(src) + 1) * compression_percent));
-		}
-		if (n <= 15) {
-			dest.push_back(fixarray_t(n));
+			dest.check_resize(packed_size_typed(src.size(), sizeof(T)));
 		}
-		else if (n <= umax16) {
-			dest.push_back(uint8_t(arr16));
-			dest.push_back(uint16_t(n));
+		pack_typed(src.data(), src.size(), dest);
+	}
+
+	// packed sizes, exact byte counts of what the pack overloads emit
+
+	size_t packed_size_uint(uint64_t src) {
+		if (src <= posmax8) {
+			return 1;
 		}
-		else if (n <= umax32) {
-			dest.push_back(uint8_t(arr32));
-			dest.push_back(uint32_t(n));
+		else if (src <= umax8) {
+			return 2;
 		}
-		for (auto& x : src) {
-			pack(x, dest, false);
+		else if (src <= umax16) {
+			return 3;
 		}
-		if (initial) {
-			// dest.shrink_to_fit();
+		else if (src <= umax32) {
+			return 5;
 		}
+		return 9;
 	}
 
-	template<typename T>
-	void pack(std::queue<T>& src, container& dest, bool initial) {
-		size_t n = src.size();
-		if (initial) {
-			dest.check_resize(size_t((LengthOf(src) + 1) * compression_percent));
-		}
-		if (n <= 15) {
-			dest.push_back(fixarray_t(n));
-		}
-		else if (n <= umax16) {
-			dest.push_back(uint8_t(arr16));
-			dest.push_back(uint16_t(n));
+	size_t packed_size_int(int64_t src) {
+		if (src >= int8_t(neg32) && src <= posmax8) {
+			return 1;
 		}
-		else if (n <= umax32) {
-			dest.push_back(uint8_t(arr32));
-			dest.push_back(uint32_t(n));
+		else if (src >= int8_t(negmax8) && src <= int8_t(posmax8)) {
+			return 2;
 		}
-		for (auto& x : src) {
-			pack(x, dest, false);
+		else if (src >= int16_t(negmax16) && src <= int16_t(posmax16)) {
+			return 3;
 		}
-		if (initial) {
-			// dest.shrink_to_fit();
+		else if (src >= int32_t(negmax32) && src <= int32_t(posmax32)) {
+			return 5;
 		}
+		return 9;
 	}
 
-	template<typename T>
-	void pack(std::deque<T>& src, container& dest, bool initial) {
-		size_t n = src.size();
-		if (initial) {
-			dest.check_resize(size_t((LengthOf(src) + 1) * compression_percent));
-		}
+	constexpr size_t packed_size_header(size_t n) {
 		if (n <= 15) {
-			dest.push_back(fixarray_t(n));
+			return 1;
 		}
 		else if (n <= umax16) {
+			return 3;
+		}
+		return 5;
+	}
+
+	constexpr size_t packed_size_str(size_t len) {
+		if (len <= fix32) {
+			return 1 + len;
+		}
+		else if (len <= umax8) {
+			return 2 + len;
+		}
+		else if (len <= umax16) {
+			return 3 + len;
+		}
+		return 5 + len;
+	}
+
+	// user defined structures, field names come from the stringized msgpack_define arguments and are split at compile time
+
+	template<size_t N>
+	constexpr std::array<std::string_view, N> split_field_names(std::string_view names) {
+		std::array<std::string_view, N> result{};
+		size_t field = 0;
+		size_t start = 0;
+		for (size_t i = 0; i <= names.size() && field < N; i++) {
+			if (i == names.size() || names[i] == ',') {
+				size_t begin = start;
+				size_t end = i;
+				while (begin < end && (names[begin] == ' ' || names[begin] == '\t' || names[begin] == '\n')) {
+					begin++;
+				}
+				while (end > begin && (names[end - 1] == ' ' || names[end - 1] == '\t' || names[end - 1] == '\n')) {
+					end--;
+				}
+				result[field++] = names.substr(begin, end - begin);
+				start = i + 1;
+			}
+		}
+		return result;
+	}
+
+	template<typename T>
+	using fields_of = decltype(std::declval<T&>().msgpack_fields());
+
+	template<typename T>
+	constexpr size_t field_count() {
+		return std::tuple_size<fields_of<T>>::value;
+	}
+
+	template<typename T>
+	inline constexpr std::array<std::string_view, field_count<T>()> field_names = split_field_names<field_count<T>()>(T::msgpack_names);
+
+	template<typename T>
+	size_t packed_size_fields(const T& src) {
+		size_t result = packed_size_header(field_count<T>());
+		if constexpr (T::msgpack_as_map) {
+			for (std::string_view name : field_names<T>) {
+				result += packed_size_str(name.size());
+			}
+		}
+		return std::apply([result](const auto&... fields) { return (result + ... + packed_size(fields)); }, src.msgpack_fields());
+	}
+
+	template<typename T>
+	constexpr size_t max_packed_size();
+	template<typename T>
+	constexpr bool fixed_bound();
+
+	template<typename T, size_t... Is>
+	constexpr size_t max_packed_elements(std::index_sequence<Is...>) {
+		return (packed_size_header(sizeof...(Is)) + ... + max_packed_size<std::remove_cv_t<std::remove_reference_t<std::tuple_element_t<Is, T>>>>());
+	}
+
+	template<typename T, size_t... Is>
+	constexpr bool fixed_bound_elements(std::index_sequence<Is...>) {
+		return (true && ... && fixed_bound<std::remove_cv_t<std::remove_reference_t<std::tuple_element_t<Is, T>>>>());
+	}
+
+	template<typename T, size_t... Is>
+	constexpr size_t max_packed_fields(std::index_sequence<Is...>) {
+		size_t result = packed_size_header(sizeof...(Is));
+		if constexpr (T::msgpack_as_map) {
+			result = (result + ... + packed_size_str(field_names<T>[Is].size()));
+		}
+		return (result + ... + max_packed_size<std::remove_cv_t<std::remove_reference_t<std::tuple_element_t<Is, fields_of<T>>>>>());
+	}
+
+	// compile time upper bound of packed_size for scalars and for structures whose fields all have one
+	template<typename T>
+	constexpr size_t max_packed_size() {
+		if constexpr (std::is_same<T, bool>::value) {
+			return 1;
+		}
+		else if constexpr (std::is_same<T, char>::value) {
+			return 2;
+		}
+		else if constexpr (std::is_same<T, float>::value) {
+			return 5;
+		}
+		else if constexpr (std::is_same<T, double>::value) {
+			return 9;
+		}
+		else if constexpr (std::is_integral<T>::value) {
+			return 1 + sizeof(T);
+		}
+		else if constexpr (is_tuple<T>::value) {
+			return max_packed_elements<T>(std::make_index_sequence<std::tuple_size<T>::value>());
+		}
+		else if constexpr (reflected<T>::value) {
+			return max_packed_fields<T>(std::make_index_sequence<field_count<T>()>());
+		}
+		else {
+			static_assert(reflected<T>::value, "no fixed upper bound on the packed size of this type");
+			return 0;
+		}
+	}
+
+	// whether max_packed_size<T> exists: bools, chars, integers, floating point numbers and tuples or structures of them
+	template<typename T>
+	constexpr bool fixed_bound() {
+		if constexpr (std::is_integral<T>::value || std::is_same<T, float>::value || std::is_same<T, double>::value) {
+			return true;
+		}
+		else if constexpr (is_tuple<T>::value) {
+			return fixed_bound_elements<T>(std::make_index_sequence<std::tuple_size<T>::value>());
+		}
+		else if constexpr (reflected<T>::value) {
+			return fixed_bound_elements<fields_of<T>>(std::make_index_sequence<field_count<T>()>());
+		}
+		else {
+			return false;
+		}
+	}
+
+	template<typename T>
+	size_t packed_size(const T& src) {
+		if constexpr (std::is_same<T, bool>::value) {
+			return 1;
+		}
+		else if constexpr (std::is_same<T, char>::value) {
+			return 2;
+		}
+		else if constexpr (std::is_same<T, double>::value) {
+			return double(float(src)) == src ? 5 : 9;
+		}
+		else if constexpr (std::is_same<T, float>::value) {
+			return 5;
+		}
+		else if constexpr (std::is_integral<T>::value && std::is_unsigned<T>::value) {
+			return packed_size_uint(uint64_t(src));
+		}
+		else if constexpr (std::is_integral<T>::value) {
+			return packed_size_int(int64_t(src));
+		}
+		else if constexpr (reflected<T>::value) {
+			return packed_size_fields(src);
+		}
+		else {
+			static_assert(std::is_pointer<T>::value || std::is_null_pointer<T>::value, "no packed_size overload for this type");
+			return 1;
+		}
+	}
+
+	size_t packed_size(const std::string& src) {
+		return packed_size_str(src.length());
+	}
+
+	size_t packed_size(std::string_view src) {
+		return packed_size_str(src.length());
+	}
+
+	size_t packed_size(const bin_view& src) {
+		return (src.size() <= umax8 ? 2 : src.size() <= umax16 ? 3 : 5) + src.size();
+	}
+
+	template<typename ...T>
+	size_t packed_size(const std::tuple<T...>& src) {
+		auto sum_size = [](const auto&... args) {
+			return (size_t(0) + ... + packed_size(args));
+		};
+		return packed_size_header(sizeof...(T)) + std::apply(sum_size, src);
+	}
+
+	template<typename T>
+	size_t packed_size(const std::vector<T>& src) {
+		if constexpr (typed_element<T>::value) {
+			if (typed_arrays_on()) {
+				return packed_size_typed(src.size(), sizeof(T));
+			}
+		}
+		size_t result = packed_size_header(src.size());
+		if constexpr (std::is_same<T, float>::value || std::is_same<T, bool>::value || std::is_same<T, char>::value) {
+			result += src.size() * packed_size(T());
+		}
+		else {
+			for (const T& e : src) {
+				result += packed_size(e);
+			}
+		}
+		return result;
+	}
+
+	template<typename T>
+	size_t packed_size(const std::list<T>& src) {
+		size_t result = packed_size_header(src.size());
+		for (const T& e : src) {
+			result += packed_size(e);
+		}
+		return result;
+	}
+
+	template<typename T>
+	size_t packed_size(const std::queue<T>& src) {
+		size_t result = packed_size_header(src.size());
+		for (const T& e : queue_container(src)) {
+			result += packed_size(e);
+		}
+		return result;
+	}
+
+	template<typename T>
+	size_t packed_size(const std::deque<T>& src) {
+		size_t result = packed_size_header(src.size());
+		for (const T& e : src) {
+			result += packed_size(e);
+		}
+		return result;
+	}
+
+	template<typename T, typename S>
+	size_t packed_size(const std::map<T, S>& src) {
+		size_t result = packed_size_header(src.size());
+		for (auto& e : src) {
+			result += packed_size(e.first);
+			result += packed_size(e.second);
+		}
+		return result;
+	}
+
+	// bulk packing of arithmetic arrays, simd kernels take uniform blocks and the scalar overloads the rest
+
+	template<typename T>
+	uint8_t* pack_bulk(const T* src, size_t n, uint8_t* out) {
+		size_t i = 0;
+		while (i < n) {
+#ifdef with_stats
+			uint8_t* start = out;
+			size_t done = simd::encode(src + i, n - i, out);
+			count_headers(start, done, true);
+			i += done;
+#else
+			i += simd::encode(src + i, n - i, out);
+#endif
+			size_t end = std::min(n, i + std::min(n - i, simd::block_size<T>()));
+			unchecked_writer writer(out);
+			for (; i < end; i++) {
+				pack(src[i], writer, false);
+			}
+			out += writer.size();
+		}
+		return out;
+	}
+
+	template<typename T, typename Sink>
+	void pack_bulk(const T* src, size_t n, Sink& dest) {
+		const size_t chunk = 512;
+		const size_t worst = chunk * 9 + 16;
+		for (size_t i = 0; i < n; i += chunk) {
+			size_t m = std::min(chunk, n - i);
+			if constexpr (std::is_same<Sink, container>::value) {
+				if (dest.capacity() - dest.size() <= worst) {
+					dest.check_resize(std::max(worst, dest.capacity() / 2));
+				}
+				uint8_t* out = dest.mutable_pointer(dest.size());
+				dest.commit(size_t(pack_bulk(src + i, m, out) - out));
+			}
+			else {
+				uint8_t buffer[worst];
+				size_t written = size_t(pack_bulk(src + i, m, buffer) - buffer);
+				dest.push_back(reinterpret_cast<const char*>(buffer), uint32_t(written));
+			}
+		}
+	}
+
+	// packing functions - STL
+
+	template<typename T, typename Sink>
+	void pack(std::vector<T>& src, Sink& dest, bool initial) {
+		if constexpr (typed_element<T>::value) {
+			if (typed_arrays_on()) {
+				pack_typed(src, dest, initial);
+				return;
+			}
+		}
+		size_t n = src.size();
+		if constexpr (presizes<Sink>::value) {
+			if (initial) {
+				dest.check_resize(msgpack_timed_sizing(size_t((LengthOf(src) + 1) * compression_percent)));
+			}
+		}
+		if (n <= 15) {
+			msgpack_count_encode(fixarray_t(n));
+			dest.push_back(fixarray_t(n));
+		}
+		else if (n <= umax16) {
+			msgpack_count_encode(arr16);
+			dest.push_back(uint8_t(arr16));
+			dest.push_back(uint16_t(n));
+		}
+		else if (n <= umax32) {
+			msgpack_count_encode(arr32);
+			dest.push_back(uint8_t(arr32));
+			dest.push_back(uint32_t(n));
+		}
+		if constexpr (simd::bulk<T>::value) {
+			pack_bulk(src.data(), n, dest);
+		}
+		else {
+			for (uint32_t i = 0; i < n; i++) {
+				pack(src[i], dest, false);
+			}
+		}
+		if (initial) {
+			// dest.shrink_to_fit();
+		}
+	}
+
+	template<typename ...T, typename Sink>
+	void pack(std::tuple<T...>& src, Sink& dest, bool initial) {
+		constexpr size_t n = sizeof...(T);
+		if constexpr (presizes<Sink>::value) {
+			if (initial) {
+				if constexpr (fixed_bound<std::tuple<T...>>()) {
+					dest.check_resize(max_packed_size<std::tuple<T...>>()); // known at compile time, no sizing pass
+				}
+				else {
+					dest.check_resize(msgpack_timed_sizing(size_t((iterate_tuple_types_2(src) + 1) * compression_percent)));
+				}
+			}
+		}
+		if constexpr (n <= 15) {
+			msgpack_count_encode(fixarray_t(n));
+			dest.push_back(fixarray_t(n));
+		}
+		else if constexpr (n <= umax16) {
+			msgpack_count_encode(arr16);
+			dest.push_back(uint8_t(arr16));
+			dest.push_back(uint16_t(n));
+		}
+		else {
+			msgpack_count_encode(arr32);
+			dest.push_back(uint8_t(arr32));
+			dest.push_back(uint32_t(n));
+		}
+
+		tuple_iterator_pack(src, dest, [](auto& dest, auto& src) { pack(src, dest, false); });
+		if (initial) {
+			// dest.shrink_to_fit();
+		}
+	}
+
+	template<typename T, typename S, typename Sink>
+	void pack(std::map<T, S>& src, Sink& dest, bool initial) {
+		size_t n = src.size();
+		if constexpr (presizes<Sink>::value) {
+			if (initial) {
+				dest.check_resize(msgpack_timed_sizing(size_t((LengthOf(src) + 1) * compression_percent)));
+			}
+		}
+		if (n <= 15) {
+			msgpack_count_encode(fixmap_t(n));
+			dest.push_back(fixmap_t(n));
+		}
+		else if (n <= umax16) {
+			msgpack_count_encode(map16);
+			dest.push_back(uint8_t(map16));
+			dest.push_back(uint16_t(n));
+		}
+		else if (n <= umax32) {
+			msgpack_count_encode(map32);
+			dest.push_back(uint8_t(map32));
+			dest.push_back(uint32_t(n));
+		}
+		for (auto& e : src) {
+			pack(e.first, dest, false);
+			pack(e.second, dest, false);
+		}
+		if (initial) {
+			// dest.shrink_to_fit();
+		}
+	}
+
+	template<typename T, typename Sink>
+	void pack(std::list<T>& src, Sink& dest, bool initial) {
+		size_t n = src.size();
+		if constexpr (presizes<Sink>::value) {
+			if (initial) {
+				dest.check_resize(msgpack_timed_sizing(size_t((LengthOf(src) + 1) * compression_percent)));
+			}
+		}
+		if (n <= 15) {
+			msgpack_count_encode(fixarray_t(n));
+			dest.push_back(fixarray_t(n));
+		}
+		else if (n <= umax16) {
+			msgpack_count_encode(arr16);
 			dest.push_back(uint8_t(arr16));
 			dest.push_back(uint16_t(n));
 		}
 		else if (n <= umax32) {
+			msgpack_count_encode(arr32);
 			dest.push_back(uint8_t(arr32));
 			dest.push_back(uint32_t(n));
 		}
@@ -577,71 +1569,286 @@ namespace msgpack {
 		}
 	}
 
+	template<typename T, typename Sink>
+	void pack(std::queue<T>& src, Sink& dest, bool initial) {
+		size_t n = src.size();
+		if constexpr (presizes<Sink>::value) {
+			if (initial) {
+				dest.check_resize(msgpack_timed_sizing(size_t((LengthOf(src) + 1) * compression_percent)));
+			}
+		}
+		if (n <= 15) {
+			msgpack_count_encode(fixarray_t(n));
+			dest.push_back(fixarray_t(n));
+		}
+		else if (n <= umax16) {
+			msgpack_count_encode(arr16);
+			dest.push_back(uint8_t(arr16));
+			dest.push_back(uint16_t(n));
+		}
+		else if (n <= umax32) {
+			msgpack_count_encode(arr32);
+			dest.push_back(uint8_t(arr32));
+			dest.push_back(uint32_t(n));
+		}
+		for (auto& x : queue_container(src)) {
+			pack(x, dest, false);
+		}
+		if (initial) {
+			// dest.shrink_to_fit();
+		}
+	}
+
+	template<typename T, typename Sink>
+	void pack(std::deque<T>& src, Sink& dest, bool initial) {
+		size_t n = src.size();
+		if constexpr (presizes<Sink>::value) {
+			if (initial) {
+				dest.check_resize(msgpack_timed_sizing(size_t((LengthOf(src) + 1) * compression_percent)));
+			}
+		}
+		if (n <= 15) {
+			msgpack_count_encode(fixarray_t(n));
+			dest.push_back(fixarray_t(n));
+		}
+		else if (n <= umax16) {
+			msgpack_count_encode(arr16);
+			dest.push_back(uint8_t(arr16));
+			dest.push_back(uint16_t(n));
+		}
+		else if (n <= umax32) {
+			msgpack_count_encode(arr32);
+			dest.push_back(uint8_t(arr32));
+			dest.push_back(uint32_t(n));
+		}
+		for (auto& x : src) {
+			pack(x, dest, false);
+		}
+		if (initial) {
+			// dest.shrink_to_fit();
+		}
+	}
+
+	// packing functions - user defined structures, fields are packed straight from the std::tie references, map keys are the field names
+
+	template<typename T, typename Tup, typename Sink, size_t... Is>
+	void pack_fields(Tup fields, Sink& dest, std::index_sequence<Is...>) {
+		if constexpr (T::msgpack_as_map) {
+			((pack(field_names<T>[Is].data(), field_names<T>[Is].size(), dest, false), pack(std::get<Is>(fields), dest, false)), ...);
+		}
+		else {
+			(pack(std::get<Is>(fields), dest, false), ...);
+		}
+	}
+
+	template<typename T, typename Sink>
+	std::enable_if_t<reflected<T>::value> pack(T& src, Sink& dest, bool initial) {
+		constexpr size_t n = field_count<T>();
+		if constexpr (presizes<Sink>::value) {
+			if (initial) {
+				dest.check_resize(msgpack_timed_sizing(size_t((LengthOf(src) + 1) * compression_percent)));
+			}
+		}
+		if constexpr (T::msgpack_as_map) {
+			if constexpr (n <= 15) {
+				msgpack_count_encode(fixmap_t(n));
+				dest.push_back(fixmap_t(n));
+			}
+			else {
+				msgpack_count_encode(map16);
+				dest.push_back(uint8_t(map16));
+				dest.push_back(uint16_t(n));
+			}
+		}
+		else {
+			if constexpr (n <= 15) {
+				msgpack_count_encode(fixarray_t(n));
+				dest.push_back(fixarray_t(n));
+			}
+			else {
+				msgpack_count_encode(arr16);
+				dest.push_back(uint8_t(arr16));
+				dest.push_back(uint16_t(n));
+			}
+		}
+		pack_fields<T>(src.msgpack_fields(), dest, std::make_index_sequence<n>());
+	}
+
+	// computes the exact packed size first, so dest is allocated once and encoded through unchecked single stores
+	template<typename T>
+	void pack_exact(T& src, container& dest) {
+		dest.check_resize(msgpack_timed_sizing(packed_size(src)));
+		unchecked_writer writer(dest.mutable_pointer(dest.size()));
+		pack(src, writer, false);
+		dest.commit(writer.size());
+	}
+
+	// stack buffer holding the largest encoding of T, for types with a compile time bound (see fixed_bound)
+	template<typename T>
+	using fixed_buffer = std::array<uint8_t, max_packed_size<T>()>;
+
+	// packs src into a buffer on the stack through unchecked single stores, nothing is allocated and no size is computed
+	// at run time, returns the number of bytes written to the front of dest
+	template<typename T, size_t N>
+	size_t pack_fixed(T& src, std::array<uint8_t, N>& dest) {
+		static_assert(N >= max_packed_size<T>(), "buffer smaller than the largest encoding");
+		unchecked_writer writer(dest.data());
+		pack(src, writer, false);
+		return writer.size();
+	}
+
 	// unpacking
 
 	template<typename T>
 	void unpack_int(T& dest, container& src, uint64_t& pos) {
+		require_valid(src, pos);
 		uint8_t header = src.get_header(pos);
+		msgpack_count_decode(header);
 		if (header >= 0 && header <= posmax8) {
-			dest = int8_t(header);
+			dest = T(header);
+		}
+		else if (header >= neg32) {
+			dest = T(int8_t(header));
 		}
 		else {
 			switch (header) {
-			case int8:
 			case uint8: {
-				dest = src.read_byte(pos);
+				dest = T(src.read_byte(pos));
 				break;
 			}
-			case int16:
 			case uint16: {
-				dest = src.read_word(pos);
+				dest = T(src.read_word(pos));
 				break;
 			}
-			case int32:
 			case uint32: {
-				dest = src.read_d_word(pos);
+				dest = T(src.read_d_word(pos));
 				break;
 			}
-			case int64:
 			case uint64: {
-				dest = src.read_q_word(pos);
+				dest = T(src.read_q_word(pos));
+				break;
+			}
+			case int8: {
+				dest = T(int8_t(src.read_byte(pos)));
+				break;
+			}
+			case int16: {
+				dest = T(int16_t(src.read_word(pos)));
+				break;
+			}
+			case int32: {
+				dest = T(src.read_d_word<int32_t>(pos));
+				break;
+			}
+			case int64: {
+				dest = T(src.read_q_word<int64_t>(pos));
 				break;
 			}
+			default: {
+				throw std::invalid_argument("not an integer at " + std::to_string(pos - 1) + "!");
+			}
 			}
 		}
 	}
 
+	// payload of a str as a view into src, pos is left after it, false with pos unchanged for other types
+	bool read_str(container& src, uint64_t& pos, std::string_view& dest) {
+		require_valid(src, pos);
+		uint64_t at = pos;
+		uint8_t header = src.get_header(at);
+		size_t n;
+		if (header >= fixstr && header <= fixstr_end) {
+			n = fixstr_len(header);
+		}
+		else if (header == str8) {
+			n = src.read_byte(at);
+		}
+		else if (header == str16) {
+			n = src.read_word(at);
+		}
+		else if (header == str32) {
+			n = src.read_d_word(at);
+		}
+		else {
+			return false;
+		}
+		msgpack_count_decode(header);
+		dest = std::string_view(reinterpret_cast<const char*>(src.raw_pointer(at)), n);
+		pos = at + n;
+		return true;
+	}
+
 	void unpack(char& dest, container& src, uint64_t& pos) {
+		require_valid(src, pos);
 		uint8_t header = src.get_header(pos);
-		if (header == single_char) {
-			dest = src.read_byte(pos);
+		msgpack_count_decode(header);
+		if (header != single_char) {
+			throw std::invalid_argument("not a char at " + std::to_string(pos - 1) + "!");
 		}
+		dest = src.read_byte(pos);
 	}
 	void unpack(std::string& dest, container& src, uint64_t& pos) {
+		require_valid(src, pos);
 		uint8_t header = src.get_header(pos);
+		msgpack_count_decode(header);
 		if (header >= fixstr && header <= fixstr_end) {
 			uint8_t n = fixstr_len(header);
-			dest.resize(n);
-			memcpy(&dest[0], src.raw_pointer(pos), fixstr_len(header));
+			dest.assign(reinterpret_cast<const char*>(src.raw_pointer(pos)), n);
 			pos += n;
 		}
 		else {
 			if (header == str8) {
 				uint8_t n = src.read_byte(pos);
-				dest.resize(n);
-				memcpy(&dest[0], src.raw_pointer(pos), n);
+				dest.assign(reinterpret_cast<const char*>(src.raw_pointer(pos)), n);
+				pos += n;
 			}
 			else if (header == str16) {
-				uint16_t n = src.read_byte(pos);
-				dest.resize(n);
-				memcpy(&dest[0], src.raw_pointer(pos), n);
+				uint16_t n = src.read_word(pos);
+				dest.assign(reinterpret_cast<const char*>(src.raw_pointer(pos)), n);
+				pos += n;
 			}
 			else if (header == str32) {
-				uint32_t n = src.read_byte(pos);
-				dest.resize(n);
-				memcpy(&dest[0], src.raw_pointer(pos), n);
+				uint32_t n = src.read_d_word(pos);
+				dest.assign(reinterpret_cast<const char*>(src.raw_pointer(pos)), n);
+				pos += n;
+			}
+			else {
+				throw std::invalid_argument("not a string at " + std::to_string(pos - 1) + "!");
+			}
+		}
+	}
+	// zero-copy decoding, the views point into src and stay valid while src is neither modified nor destroyed
+	void unpack(std::string_view& dest, container& src, uint64_t& pos) {
+		if (!read_str(src, pos, dest)) {
+			throw std::invalid_argument("not a string at " + std::to_string(pos) + "!");
+		}
+	}
+	// bin payloads, or the bytes of a str
+	void unpack(bin_view& dest, container& src, uint64_t& pos) {
+		require_valid(src, pos);
+		uint64_t at = pos;
+		uint8_t header = src.get_header(at);
+		size_t n;
+		if (header == bin8) {
+			n = src.read_byte(at);
+		}
+		else if (header == bin16) {
+			n = src.read_word(at);
+		}
+		else if (header == bin32) {
+			n = src.read_d_word(at);
+		}
+		else {
+			std::string_view str;
+			if (!read_str(src, pos, str)) {
+				throw std::invalid_argument("not a bin or string at " + std::to_string(pos) + "!");
 			}
+			dest = bin_view(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+			return;
 		}
+		msgpack_count_decode(header);
+		dest = bin_view(src.raw_pointer(at), n);
+		pos = at + n;
 	}
 	void unpack(uint8_t& dest, container& src, uint64_t& pos) {
 		unpack_int(dest, src, pos);
@@ -668,31 +1875,205 @@ namespace msgpack {
 		unpack_int(dest, src, pos);
 	}
 	void unpack(double& dest, container& src, uint64_t& pos) {
+		require_valid(src, pos);
 		uint8_t header = src.get_header(pos);
+		msgpack_count_decode(header);
 		if (header == float32) {
 			dest = (double)src.read_d_word<float>(pos);
 		}
-		else {
+		else if (header == float64) {
 			dest = src.read_q_word<double>(pos);
 		}
+		else {
+			throw std::invalid_argument("not a floating point number at " + std::to_string(pos - 1) + "!");
+		}
 	}
 	void unpack(float& dest, container& src, uint64_t& pos) {
-		pos++; // skip header
-		dest = src.read_d_word<float>(pos);
+		require_valid(src, pos);
+		uint8_t header = src.get_header(pos);
+		msgpack_count_decode(header);
+		if (header == float32) {
+			dest = src.read_d_word<float>(pos);
+		}
+		else if (header == float64) {
+			dest = float(src.read_q_word<double>(pos));
+		}
+		else {
+			throw std::invalid_argument("not a floating point number at " + std::to_string(pos - 1) + "!");
+		}
 	}
 	void unpack(bool& dest, container& src, uint64_t& pos) {
-		dest = src.get_header(pos);
+		require_valid(src, pos);
+		uint8_t header = src.get_header(pos);
+		msgpack_count_decode(header);
+		if (header != tru && header != flse) {
+			throw std::invalid_argument("not a bool at " + std::to_string(pos - 1) + "!");
+		}
+		dest = header == tru;
+	}
+
+	// bulk unpacking of arithmetic arrays, simd kernels decode runs of same-width elements and the scalar overloads the rest
+	template<typename T>
+	void unpack_bulk(T* dest, size_t n, container& src, uint64_t& pos) {
+		size_t i = 0;
+		while (i < n) {
+#ifdef with_stats
+			uint64_t start = pos;
+			size_t done = simd::decode(dest + i, n - i, src.raw_pointer(), src.size(), pos);
+			count_headers(src.raw_pointer(start), done, false);
+			i += done;
+#else
+			i += simd::decode(dest + i, n - i, src.raw_pointer(), src.size(), pos);
+#endif
+			if (i < n) {
+				unpack(dest[i], src, pos);
+				i++;
+			}
+		}
+	}
+
+	// typed array records
+
+	bool is_typed_array(container& src, uint64_t pos) {
+		if (pos >= src.size()) {
+			return false;
+		}
+		uint8_t header = *src.raw_pointer(pos);
+		uint64_t type = header == ext8 ? pos + 2 : header == ext16 ? pos + 3 : header == ext32 ? pos + 5 : 0;
+		return type != 0 && type + 1 < src.size() && *src.raw_pointer(type) == typed_array_ext;
+	}
+
+	// reads the record header, leaves pos at the first element and returns the element count
+	size_t typed_array_header(container& src, uint64_t& pos, element_kind& kind) {
+		if (!is_typed_array(src, pos)) {
+			throw std::invalid_argument("no typed array at " + std::to_string(pos) + "!");
+		}
+		require_valid(src, pos);
+		uint8_t header = src.get_header(pos);
+		msgpack_count_decode(header);
+		size_t len = header == ext8 ? src.read_byte(pos) : header == ext16 ? src.read_word(pos) : src.read_d_word(pos);
+		pos++; // skip ext type
+		kind = element_kind(src.read_byte(pos));
+		size_t width = element_width(kind);
+		if (width == 0 || len == 0 || (len - 1) % width != 0) {
+			throw std::invalid_argument("malformed typed array at " + std::to_string(pos) + "!");
+		}
+		if (pos + len - 1 > src.size()) {
+			throw std::out_of_range(std::to_string(pos + len - 1) + " out of range!");
+		}
+		return (len - 1) / width;
+	}
+
+	template<typename T, typename S>
+	void convert_typed(T* dest, size_t n, const uint8_t* src) {
+		for (size_t i = 0; i < n; i++) {
+			dest[i] = T(load_little<S>(src + i * sizeof(S)));
+		}
+	}
+
+	// one memcpy when the element kind matches T, an element-wise conversion otherwise
+	template<typename T>
+	void unpack_typed(T* dest, size_t n, element_kind kind, const uint8_t* src) {
+		if (little_endian_host() && kind == element_kind_of<T>()) {
+			if (n != 0) {
+				memcpy(dest, src, n * sizeof(T));
+			}
+			return;
+		}
+		switch (kind) {
+		case element_kind::u8: convert_typed<T, uint8_t>(dest, n, src); break;
+		case element_kind::u16: convert_typed<T, uint16_t>(dest, n, src); break;
+		case element_kind::u32: convert_typed<T, uint32_t>(dest, n, src); break;
+		case element_kind::u64: convert_typed<T, uint64_t>(dest, n, src); break;
+		case element_kind::i8: convert_typed<T, int8_t>(dest, n, src); break;
+		case element_kind::i16: convert_typed<T, int16_t>(dest, n, src); break;
+		case element_kind::i32: convert_typed<T, int32_t>(dest, n, src); break;
+		case element_kind::i64: convert_typed<T, int64_t>(dest, n, src); break;
+		case element_kind::f32: convert_typed<T, float>(dest, n, src); break;
+		case element_kind::f64: convert_typed<T, double>(dest, n, src); break;
+		}
+	}
+
+	// zero-copy span over the elements of a typed array record, valid while the source container is
+	template<typename T>
+	class typed_array_view {
+	public:
+
+		typed_array_view() : data(nullptr), n(0) {};
+		typed_array_view(const uint8_t* src, size_t len) : data(src), n(len) {};
+
+		T operator[](size_t i) const {
+			return load_little<T>(data + i * sizeof(T));
+		}
+
+		size_t size() const {
+			return n;
+		}
+		bool empty() const {
+			return n == 0;
+		}
+		const uint8_t* raw_pointer() const {
+			return data;
+		}
+
+		// the elements as T* when they can be used in place (little endian host, payload aligned for T), nullptr otherwise
+		const T* aligned() const {
+			if (little_endian_host() && reinterpret_cast<uintptr_t>(data) % alignof(T) == 0) {
+				return reinterpret_cast<const T*>(data);
+			}
+			return nullptr;
+		}
+
+		void copy_to(T* dest) const {
+			unpack_typed(dest, n, element_kind_of<T>(), data);
+		}
+
+	private:
+
+		const uint8_t* data;
+		size_t n;
+	};
+
+	template<typename T>
+	void unpack(typed_array_view<T>& dest, container& src, uint64_t& pos) {
+		element_kind kind;
+		size_t n = typed_array_header(src, pos, kind);
+		if (kind != element_kind_of<T>()) {
+			throw std::invalid_argument("typed array holds another element kind!");
+		}
+		dest = typed_array_view<T>(src.raw_pointer(pos), n);
+		pos += n * sizeof(T);
 	}
 
 	template<typename T>
 	void unpack(std::vector<T>& dest, container& src, uint64_t& pos) {
 		static_assert(!std::is_same<void, T>::value);
+		if constexpr (typed_element<T>::value) {
+			if (is_typed_array(src, pos)) {
+				element_kind kind;
+				size_t n = typed_array_header(src, pos, kind);
+				dest.resize(n);
+				unpack_typed(dest.data(), n, kind, src.raw_pointer(pos));
+				pos += n * element_width(kind);
+				return;
+			}
+		}
 		size_t n = element_size(src, pos);
 		dest.resize(n);
-		for (uint64_t i = 0; i < n; i++) {
-			T temp;
-			unpack(temp, src, pos);
-			dest[i] = temp;
+		if constexpr (simd::bulk<T>::value) {
+			unpack_bulk(dest.data(), n, src, pos);
+		}
+		else if constexpr (std::is_same<T, bool>::value) {
+			for (uint64_t i = 0; i < n; i++) {
+				bool value;
+				unpack(value, src, pos);
+				dest[i] = value; // std::vector<bool> hands out proxies
+			}
+		}
+		else {
+			for (uint64_t i = 0; i < n; i++) {
+				unpack(dest[i], src, pos);
+			}
 		}
 	}
 
@@ -705,37 +2086,60 @@ namespace msgpack {
 	template<typename T, typename S>
 	void unpack(std::map<T, S>& dest, container& src, uint64_t& pos) {
 		size_t n = element_size(src, pos);
+		// the previous entries are recycled: their nodes, and the capacity of the keys and values inside them, are refilled
+		// before any new node is allocated (the spare map is per thread so swapping into it never allocates)
+		thread_local std::map<T, S> spare;
+		spare.clear();
+		spare.swap(dest);
 		for (uint64_t i = 0; i < n; i++) {
-			T first;
-			S second;
-			unpack(first, src, pos);
-			unpack(second, src, pos);
-			dest.insert({ first, second });
+			// maps are packed in key order, so the end hint makes each insertion O(1)
+			typename std::map<T, S>::iterator it;
+			if (!spare.empty()) {
+				auto node = spare.extract(spare.begin());
+				unpack(node.key(), src, pos);
+				it = dest.insert(dest.end(), std::move(node));
+				if (node) {
+					skip(src, pos); // duplicate keys keep the first value
+					continue;
+				}
+			}
+			else {
+				T first;
+				unpack(first, src, pos);
+				size_t before = dest.size();
+				it = dest.try_emplace(dest.end(), std::move(first));
+				if (dest.size() == before) {
+					skip(src, pos);
+					continue;
+				}
+			}
+			unpack(it->second, src, pos);
 		}
+		spare.clear();
 	}
 
 	template<typename T>
 	void unpack(std::list<T>& dest, container& src, uint64_t& pos) {
 		static_assert(!std::is_same<void, T>::value);
 		size_t n = element_size(src, pos);
-		dest.resize(n);
+		// existing nodes are refilled first
+		auto it = dest.begin();
 		for (uint64_t i = 0; i < n; i++) {
-			T temp;
-			unpack(temp, src, pos);
-			dest.push_back(temp);
+			if (it == dest.end()) {
+				unpack(dest.emplace_back(), src, pos);
+			}
+			else {
+				unpack(*it, src, pos);
+				++it;
+			}
 		}
+		dest.erase(it, dest.end());
 	}
 
 	template<typename T>
 	void unpack(std::queue<T>& dest, container& src, uint64_t& pos) {
 		static_assert(!std::is_same<void, T>::value);
-		size_t n = element_size(src, pos);
-		dest.resize(n);
-		for (uint64_t i = 0; i < n; i++) {
-			T temp;
-			unpack(temp, src, pos);
-			dest.push(temp);
-		}
+		unpack(queue_container(dest), src, pos);
 	}
 
 	template<typename T>
@@ -744,12 +2148,54 @@ namespace msgpack {
 		size_t n = element_size(src, pos);
 		dest.resize(n);
 		for (uint64_t i = 0; i < n; i++) {
-			T temp;
-			unpack(temp, src, pos);
-			dest.push(temp);
+			unpack(dest[i], src, pos);
+		}
+	}
+
+	// unpacking - user defined structures, arrays fill the fields in order and maps match keys against the field names,
+	// missing fields keep their values and unknown keys or extra elements are skipped
+
+	// unpacks into field i of the std::tie tuple, false when there is no such field
+	template<typename Tup, size_t... Is>
+	bool unpack_field(Tup fields, size_t i, container& src, uint64_t& pos, std::index_sequence<Is...>) {
+		return ((i == Is ? (unpack(std::get<Is>(fields), src, pos), true) : false) || ...);
+	}
+
+	template<typename T>
+	std::enable_if_t<reflected<T>::value> unpack(T& dest, container& src, uint64_t& pos) {
+		constexpr size_t n = field_count<T>();
+		auto fields = dest.msgpack_fields();
+		size_t count = element_size(src, pos);
+		if constexpr (T::msgpack_as_map) {
+			for (size_t i = 0; i < count; i++) {
+				std::string_view key;
+				size_t field = n;
+				if (read_str(src, pos, key)) {
+					for (field = 0; field < n && field_names<T>[field] != key; field++);
+				}
+				else {
+					skip(src, pos);
+				}
+				if (!unpack_field(fields, field, src, pos, std::make_index_sequence<n>())) {
+					skip(src, pos);
+				}
+			}
+		}
+		else {
+			for (size_t i = 0; i < count; i++) {
+				if (!unpack_field(fields, i, src, pos, std::make_index_sequence<n>())) {
+					skip(src, pos);
+				}
+			}
 		}
 	}
 
+	template<typename T>
+	std::enable_if_t<reflected<T>::value> unpack(T& dest, container& src) {
+		uint64_t pos = 0;
+		unpack(dest, src, pos);
+	}
+
 	template<typename T>
 	void unpack(std::vector<T>& dest, container& src) {
 		uint64_t pos = 0;
@@ -0,0 +1,456 @@
+#ifndef OBJECT_HPP
+#define OBJECT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "msgpack.hpp"
+#include "view.hpp"
+#include "visitor.hpp"
+
+namespace msgpack {
+	// bump pointer arena: allocations are carved out of large chunks and never freed one by one, clear() releases all of
+	// them at once in O(1) and keeps the chunks for the next message
+
+	class zone {
+	public:
+
+		zone(size_t chunk = 0x10000) : chunk_size(chunk) {};
+		zone(const zone&) = delete;
+		zone& operator=(const zone&) = delete;
+
+		void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+			while (true) {
+				if (current < chunks.size()) {
+					uintptr_t base = reinterpret_cast<uintptr_t>(chunks[current].data.get());
+					size_t start = ((base + cursor + align - 1) & ~uintptr_t(align - 1)) - base;
+					if (start + bytes <= chunks[current].size) {
+						cursor = start + bytes;
+						used_bytes += bytes;
+						return chunks[current].data.get() + start;
+					}
+					// too small for this one, later chunks (kept from earlier messages) may fit
+					current++;
+					cursor = 0;
+					continue;
+				}
+				size_t size = std::max(chunk_size, bytes + align);
+				chunks.push_back({ std::unique_ptr<uint8_t[]>(new uint8_t[size]), size });
+			}
+		}
+		template<typename T>
+		T* allocate_array(size_t n) {
+			return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+		}
+		// everything allocated so far becomes invalid
+		void clear() {
+			current = 0;
+			cursor = 0;
+			used_bytes = 0;
+		}
+		// bytes handed out since the last clear
+		size_t used() const {
+			return used_bytes;
+		}
+		// bytes held in chunks
+		size_t capacity() const {
+			size_t result = 0;
+			for (auto& c : chunks) {
+				result += c.size;
+			}
+			return result;
+		}
+
+	private:
+
+		struct chunk {
+			std::unique_ptr<uint8_t[]> data;
+			size_t size;
+		};
+
+		std::vector<chunk> chunks;
+		size_t chunk_size;
+		size_t current = 0;
+		size_t cursor = 0;
+		size_t used_bytes = 0;
+	};
+
+	// dynamically typed value for data without a schema, 16 bytes each, arrays and maps point to their elements in the
+	// zone they were decoded into (map keys and values in turn), str, bin and ext point into the packed bytes when
+	// borrowed or into the zone otherwise, so the object is valid while both are
+
+	class object {
+	public:
+
+		object() : k(kind::null), ext(0), n(0), u(0) {};
+
+		// inspection
+
+		kind type() const {
+			return k;
+		}
+		bool is_nil() const {
+			return k == kind::null;
+		}
+		// elements of an array, entries of a map, bytes of a str, bin or ext data, 0 for scalars
+		size_t size() const {
+			return n;
+		}
+
+		// typed accessors
+
+		bool as_bool() const {
+			if (k != kind::boolean) {
+				throw std::invalid_argument("not a bool!");
+			}
+			return u != 0;
+		}
+		uint64_t as_uint() const {
+			if (k == kind::uint || (k == kind::sint && i >= 0)) {
+				return u;
+			}
+			throw std::range_error("not an unsigned integer!");
+		}
+		int64_t as_int() const {
+			if (k == kind::sint || (k == kind::uint && u <= uint64_t(posmax64))) {
+				return i;
+			}
+			throw std::range_error("not a signed integer!");
+		}
+		double as_double() const {
+			switch (k) {
+			case kind::f32: {
+				return double(f);
+			}
+			case kind::f64: {
+				return d;
+			}
+			case kind::uint: {
+				return double(u);
+			}
+			case kind::sint: {
+				return double(i);
+			}
+			default: {
+				throw std::invalid_argument("not a number!");
+			}
+			}
+		}
+		// str and bin payloads
+		std::string_view as_string() const {
+			if (k != kind::str && k != kind::bin) {
+				throw std::invalid_argument("not a string!");
+			}
+			return std::string_view(reinterpret_cast<const char*>(bytes), n);
+		}
+		bin_view as_bin() const {
+			if (k != kind::str && k != kind::bin && k != kind::ext) {
+				throw std::invalid_argument("not binary!");
+			}
+			return bin_view(bytes, n);
+		}
+		int8_t ext_type() const {
+			if (k != kind::ext) {
+				throw std::invalid_argument("not an ext!");
+			}
+			return ext;
+		}
+
+		// navigation
+
+		// i-th element of an array
+		const object& operator[](size_t index) const {
+			if (k != kind::array) {
+				throw std::invalid_argument("not an array!");
+			}
+			if (index >= n) {
+				throw std::out_of_range(std::to_string(index) + " out of range!");
+			}
+			return items[index];
+		}
+		// key and value of the i-th entry of a map
+		const object& key(size_t index) const {
+			return entry(index, 0);
+		}
+		const object& value(size_t index) const {
+			return entry(index, 1);
+		}
+		// value stored under a string key of a map, nullptr when missing
+		const object* find(std::string_view name) const {
+			if (k != kind::map) {
+				throw std::invalid_argument("not a map!");
+			}
+			for (uint32_t e = 0; e < n; e++) {
+				const object& candidate = items[e * 2];
+				if (candidate.k == kind::str && candidate.as_string() == name) {
+					return &items[e * 2 + 1];
+				}
+			}
+			return nullptr;
+		}
+		const object& operator[](std::string_view name) const {
+			const object* result = find(name);
+			if (result == nullptr) {
+				throw std::out_of_range(std::string(name) + " not found!");
+			}
+			return *result;
+		}
+
+	private:
+
+		friend class object_builder;
+
+		const object& entry(size_t index, size_t half) const {
+			if (k != kind::map) {
+				throw std::invalid_argument("not a map!");
+			}
+			if (index >= n) {
+				throw std::out_of_range(std::to_string(index) + " out of range!");
+			}
+			return items[index * 2 + half];
+		}
+
+		kind k;
+		int8_t ext;
+		uint32_t n;
+		union {
+			uint64_t u;
+			int64_t i;
+			float f;
+			double d;
+			const uint8_t* bytes;
+			object* items;
+		};
+	};
+
+	// msgpack::parse visitor building an object tree in a zone, elements of an array or map are allocated in one
+	// piece when its header is seen and filled in order
+
+	class object_builder : public visitor {
+	public:
+
+		object_builder(object& root, zone& arena, bool borrow) : root(root), arena(arena), borrow(borrow) {};
+
+		void on_nil() {
+			next().k = kind::null;
+		}
+		void on_bool(bool value) {
+			object& o = next();
+			o.k = kind::boolean;
+			o.u = value ? 1 : 0;
+		}
+		void on_uint(uint64_t value) {
+			object& o = next();
+			o.k = kind::uint;
+			o.u = value;
+		}
+		void on_int(int64_t value) {
+			object& o = next();
+			o.k = kind::sint;
+			o.i = value;
+		}
+		void on_float(float value) {
+			object& o = next();
+			o.k = kind::f32;
+			o.f = value;
+		}
+		void on_double(double value) {
+			object& o = next();
+			o.k = kind::f64;
+			o.d = value;
+		}
+		void on_str(std::string_view value) {
+			payload(next(), kind::str, reinterpret_cast<const uint8_t*>(value.data()), value.size());
+		}
+		void on_bin(bin_view value) {
+			payload(next(), kind::bin, value.data(), value.size());
+		}
+		void on_ext(int8_t type, bin_view value) {
+			object& o = next();
+			payload(o, kind::ext, value.data(), value.size());
+			o.ext = type;
+		}
+		void on_array_begin(size_t count) {
+			open(next(), kind::array, count, count);
+		}
+		void on_map_begin(size_t count) {
+			open(next(), kind::map, count, count * 2);
+		}
+		void on_array_end() {
+			depth--;
+		}
+		void on_map_end() {
+			depth--;
+		}
+
+	private:
+
+		struct frame {
+			object* items;
+			size_t filled;
+		};
+
+		// slot of the value that starts now
+		object& next() {
+			if (depth == 0) {
+				return root;
+			}
+			frame& top = stack[depth - 1];
+			return top.items[top.filled++];
+		}
+		void payload(object& o, kind k, const uint8_t* src, size_t len) {
+			o.k = k;
+			o.n = uint32_t(len);
+			if (borrow || len == 0) {
+				o.bytes = src;
+			}
+			else {
+				uint8_t* copy = arena.allocate_array<uint8_t>(len);
+				memcpy(copy, src, len);
+				o.bytes = copy;
+			}
+		}
+		void open(object& o, kind k, size_t count, size_t slots) {
+			o.k = k;
+			o.n = uint32_t(count);
+			o.items = slots == 0 ? nullptr : new (arena.allocate_array<object>(slots)) object[slots];
+			stack[depth++] = { o.items, 0 }; // popped by on_array_end / on_map_end, empty ones included
+		}
+
+		object& root;
+		zone& arena;
+		bool borrow;
+		frame stack[parse_depth];
+		size_t depth = 0;
+	};
+
+	// decodes one value of any shape at pos into dest, arrays, maps and (unless borrow) string payloads are allocated
+	// in arena, borrowed payloads point into src, which must then outlive dest and stay unmodified
+	void unpack(object& dest, container& src, zone& arena, uint64_t& pos, bool borrow = true) {
+		object_builder builder(dest, arena, borrow);
+		parse(src, builder, pos);
+	}
+
+	void unpack(object& dest, container& src, zone& arena, bool borrow = true) {
+		uint64_t pos = 0;
+		unpack(dest, src, arena, pos, borrow);
+	}
+
+	// packs a decoded object back, same values and types with integers in their smallest format and ext records as
+	// ext8 / 16 / 32
+	template<typename Sink>
+	void pack(const object& src, Sink& dest, bool initial = false) {
+		switch (src.type()) {
+		case kind::null: {
+			msgpack_count_encode(nil);
+			dest.push_back(uint8_t(nil));
+			break;
+		}
+		case kind::boolean: {
+			pack(src.as_bool(), dest);
+			break;
+		}
+		case kind::uint: {
+			pack_uint(src.as_uint(), dest);
+			break;
+		}
+		case kind::sint: {
+			pack_int(src.as_int(), dest);
+			break;
+		}
+		case kind::f32: {
+			pack(float(src.as_double()), dest);
+			break;
+		}
+		case kind::f64: {
+			msgpack_count_encode(float64);
+			dest.push_back(uint8_t(float64));
+			dest.push_back(src.as_double());
+			break;
+		}
+		case kind::str: {
+			pack(src.as_string(), dest);
+			break;
+		}
+		case kind::bin: {
+			pack(src.as_bin(), dest);
+			break;
+		}
+		case kind::ext: {
+			size_t len = src.size();
+			if (len <= umax8) {
+				msgpack_count_encode(ext8);
+				dest.push_back(uint8_t(ext8));
+				dest.push_back(uint8_t(len));
+			}
+			else if (len <= umax16) {
+				msgpack_count_encode(ext16);
+				dest.push_back(uint8_t(ext16));
+				dest.push_back(uint16_t(len));
+			}
+			else {
+				msgpack_count_encode(ext32);
+				dest.push_back(uint8_t(ext32));
+				dest.push_back(uint32_t(len));
+			}
+			dest.push_back(uint8_t(src.ext_type()));
+			if (len != 0) {
+				dest.push_back(reinterpret_cast<const char*>(src.as_bin().data()), uint32_t(len));
+			}
+			break;
+		}
+		case kind::array: {
+			size_t n = src.size();
+			if (n <= 15) {
+				msgpack_count_encode(fixarray_t(n));
+				dest.push_back(fixarray_t(n));
+			}
+			else if (n <= umax16) {
+				msgpack_count_encode(arr16);
+				dest.push_back(uint8_t(arr16));
+				dest.push_back(uint16_t(n));
+			}
+			else {
+				msgpack_count_encode(arr32);
+				dest.push_back(uint8_t(arr32));
+				dest.push_back(uint32_t(n));
+			}
+			for (size_t e = 0; e < n; e++) {
+				pack(src[e], dest);
+			}
+			break;
+		}
+		case kind::map: {
+			size_t n = src.size();
+			if (n <= 15) {
+				msgpack_count_encode(fixmap_t(n));
+				dest.push_back(fixmap_t(n));
+			}
+			else if (n <= umax16) {
+				msgpack_count_encode(map16);
+				dest.push_back(uint8_t(map16));
+				dest.push_back(uint16_t(n));
+			}
+			else {
+				msgpack_count_encode(map32);
+				dest.push_back(uint8_t(map32));
+				dest.push_back(uint32_t(n));
+			}
+			for (size_t e = 0; e < n; e++) {
+				pack(src.key(e), dest);
+				pack(src.value(e), dest);
+			}
+			break;
+		}
+		}
+	}
+};
+
+#endif
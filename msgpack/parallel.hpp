@@ -0,0 +1,183 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "msgpack.hpp"
+
+namespace msgpack {
+	// worker count used when none is given, one per hardware thread
+
+	unsigned parallel_threads() {
+		unsigned n = std::thread::hardware_concurrency();
+		return n == 0 ? 1 : n;
+	}
+
+	// runs task(i) for every i in [0, n) on up to threads workers (the calling thread is one of them), tasks are handed out
+	// one at a time so uneven ones balance out, the first exception stops the remaining tasks and is rethrown
+	template<typename F>
+	void parallel_for(size_t n, unsigned threads, F task) {
+		std::atomic<size_t> next(0);
+		std::exception_ptr error;
+		std::mutex error_lock;
+		auto work = [&]() {
+			for (size_t i = next++; i < n; i = next++) {
+				try {
+					task(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> guard(error_lock);
+					if (!error) {
+						error = std::current_exception();
+					}
+					next = n;
+				}
+			}
+		};
+		size_t count = std::min<size_t>(threads, n);
+		std::vector<std::thread> workers;
+		for (size_t t = 1; t < count; t++) {
+			workers.emplace_back(work);
+		}
+		work();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	// packs src as a single array, same bytes as pack(src, dest): chunks of elements are encoded into their own containers
+	// on the workers, then copied behind the array header at offsets from a prefix sum of the chunk sizes, also in parallel
+	template<typename T>
+	void parallel_pack(std::vector<T>& src, container& dest, unsigned threads = 0) {
+		if (threads == 0) {
+			threads = parallel_threads();
+		}
+		size_t n = src.size();
+		// read once so the sizes and bytes of every chunk agree even if the default changes meanwhile
+		bool typed = typed_arrays_on();
+		if constexpr (typed_element<T>::value) {
+			if (typed) {
+				pack(src, dest); // a single memcpy already
+				return;
+			}
+		}
+		if (threads <= 1 || n < 2 * size_t(threads)) {
+			pack(src, dest);
+			return;
+		}
+
+		// a few chunks per worker keeps them all busy when element sizes vary
+		size_t step = (n + size_t(threads) * 4 - 1) / (size_t(threads) * 4);
+		size_t chunks = (n + step - 1) / step;
+		std::vector<container> parts(chunks);
+		parallel_for(chunks, threads, [&](size_t k) {
+			typed_arrays_scope scope(typed);
+			size_t begin = k * step;
+			size_t end = std::min(n, begin + step);
+			container& part = parts[k];
+			if constexpr (simd::bulk<T>::value) {
+				pack_bulk(src.data() + begin, end - begin, part);
+			}
+			else {
+				size_t size = 0;
+				for (size_t i = begin; i < end; i++) {
+					size += packed_size(src[i]);
+				}
+				part.check_resize(size);
+				unchecked_writer writer(part.mutable_pointer(part.size()));
+				for (size_t i = begin; i < end; i++) {
+					pack(src[i], writer, false);
+				}
+				part.commit(writer.size());
+			}
+		});
+
+		std::vector<size_t> offsets(chunks + 1, 0);
+		for (size_t k = 0; k < chunks; k++) {
+			offsets[k + 1] = offsets[k] + parts[k].size();
+		}
+		size_t total = offsets[chunks];
+		dest.check_resize(packed_size_header(n) + total);
+		if (n <= 15) {
+			msgpack_count_encode(fixarray_t(n));
+			dest.push_back(fixarray_t(n));
+		}
+		else if (n <= umax16) {
+			msgpack_count_encode(arr16);
+			dest.push_back(uint8_t(arr16));
+			dest.push_back(uint16_t(n));
+		}
+		else if (n <= umax32) {
+			msgpack_count_encode(arr32);
+			dest.push_back(uint8_t(arr32));
+			dest.push_back(uint32_t(n));
+		}
+		uint8_t* base = dest.mutable_pointer(dest.size());
+		parallel_for(chunks, threads, [&](size_t k) {
+			memcpy(base + offsets[k], parts[k].raw_pointer(), parts[k].size());
+		});
+		dest.commit(total);
+	}
+
+	// unpacks the array at pos into dest: a structural pass (build_index) finds every element offset first, then ranges
+	// of elements are decoded on the workers straight into their slots of the pre-sized vector
+	template<typename T>
+	void parallel_unpack(std::vector<T>& dest, container& src, uint64_t& pos, unsigned threads = 0) {
+		if (threads == 0) {
+			threads = parallel_threads();
+		}
+		if constexpr (typed_element<T>::value) {
+			if (is_typed_array(src, pos)) {
+				unpack(dest, src, pos); // a single memcpy already
+				return;
+			}
+		}
+		if (threads <= 1) {
+			unpack(dest, src, pos);
+			return;
+		}
+		require_valid(src, pos); // once here, so the workers only read the validated range
+		offset_index index = build_index(src, pos);
+		if (index.pairs) {
+			throw std::invalid_argument("not an array!");
+		}
+		size_t n = index.size();
+		dest.resize(n);
+		if (n != 0) {
+			size_t step = (n + size_t(threads) * 4 - 1) / (size_t(threads) * 4);
+			size_t chunks = (n + step - 1) / step;
+			parallel_for(chunks, threads, [&](size_t k) {
+				size_t begin = k * step;
+				size_t end = std::min(n, begin + step);
+				uint64_t at = index[begin];
+				if constexpr (simd::bulk<T>::value) {
+					unpack_bulk(dest.data() + begin, end - begin, src, at);
+				}
+				else {
+					for (size_t i = begin; i < end; i++) {
+						unpack(dest[i], src, at);
+					}
+				}
+			});
+		}
+		pos = index.end();
+	}
+
+	template<typename T>
+	void parallel_unpack(std::vector<T>& dest, container& src, unsigned threads = 0) {
+		uint64_t pos = 0;
+		parallel_unpack(dest, src, pos, threads);
+	}
+};
+
+#endif
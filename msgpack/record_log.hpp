@@ -0,0 +1,458 @@
+#ifndef RECORD_LOG_HPP
+#define RECORD_LOG_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "msgpack.hpp"
+#include "simd.hpp"
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace msgpack {
+	// crc32c (castagnoli), with the SSE4.2 / ARMv8 crc32 instructions when the cpu has them
+
+	inline const uint32_t* crc32c_table() {
+		static const std::array<uint32_t, 256> table = []() {
+			std::array<uint32_t, 256> result{};
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++) {
+					c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : c >> 1;
+				}
+				result[i] = c;
+			}
+			return result;
+		}();
+		return table.data();
+	}
+
+#ifdef msgpack_simd_x86
+	msgpack_target("sse4.2") inline uint32_t crc32c_sse42(const uint8_t* data, size_t len, uint32_t crc) {
+#if defined(__x86_64__) || defined(_M_X64)
+		uint64_t wide = crc;
+		for (; len >= 8; data += 8, len -= 8) {
+			uint64_t word;
+			memcpy(&word, data, 8);
+			wide = _mm_crc32_u64(wide, word);
+		}
+		crc = uint32_t(wide);
+#endif
+		for (; len >= 4; data += 4, len -= 4) {
+			uint32_t word;
+			memcpy(&word, data, 4);
+			crc = _mm_crc32_u32(crc, word);
+		}
+		for (; len > 0; data++, len--) {
+			crc = _mm_crc32_u8(crc, *data);
+		}
+		return crc;
+	}
+#endif
+
+	// crc of len bytes continuing from crc (0 to start), so a record can be checksummed in pieces
+	inline uint32_t crc32c(const uint8_t* data, size_t len, uint32_t crc = 0) {
+		crc = ~crc;
+#if defined(msgpack_simd_x86)
+		if (simd::level() != simd::isa::scalar) {
+			return ~crc32c_sse42(data, len, crc);
+		}
+#elif defined(__ARM_FEATURE_CRC32)
+		for (; len >= 8; data += 8, len -= 8) {
+			uint64_t word;
+			memcpy(&word, data, 8);
+			crc = __crc32cd(crc, word);
+		}
+		for (; len > 0; data++, len--) {
+			crc = __crc32cb(crc, *data);
+		}
+		return ~crc;
+#endif
+		const uint32_t* table = crc32c_table();
+		for (; len > 0; data++, len--) {
+			crc = table[(crc ^ *data) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	// record log: an append-only file of packed records in checksummed blocks, all integers big endian
+	//   block   [sync marker, 16][payload length, 4][records, 4][first record, 8][first timestamp, 8][crc32c, 4][payload]
+	//   payload [record length, 4][timestamp, 8][packed record] per record
+	//   index   [index magic, 4][blocks, 8] then [offset, 8][first record, 8][first timestamp, 8][records, 4] per block,
+	//           written once when the log is closed
+	//   footer  [index offset, 8][crc32c of the index, 4][footer magic, 4], the last 16 bytes of the file
+	// the crc of a block covers its header fields after the sync marker and its payload, the sync marker starts every
+	// block so a reader can find the next intact block after a torn or corrupt one, the index lets a closed log be
+	// opened without reading it
+
+	namespace record_log {
+		constexpr uint8_t sync_marker[16] = { 0x89, 'm', 's', 'g', 'p', 'a', 'c', 'k', '-', 'l', 'o', 'g', 0x0D, 0x0A, 0x1A, 0x0A };
+		constexpr uint32_t index_magic = 0x4D504C49; // MPLI
+		constexpr uint32_t footer_magic = 0x4D504C46; // MPLF
+		constexpr size_t block_header_size = 44;
+		constexpr size_t frame_header_size = 12;
+		constexpr size_t index_entry_size = 28;
+		constexpr size_t footer_size = 16;
+
+		struct block_entry {
+			uint64_t offset;
+			uint64_t first; // number of the first record
+			int64_t timestamp; // of the first record
+			uint32_t records;
+		};
+
+		// sinks that report the bytes already in them (container, span_sink, mapped_sink), block offsets then count
+		// from the start of the sink, for streams they count from where the log starts
+		template<typename Sink, typename = void>
+		struct sized : std::false_type {};
+		template<typename Sink>
+		struct sized<Sink, std::void_t<decltype(std::declval<const Sink&>().size())>> : std::true_type {};
+
+		template<typename Sink>
+		uint64_t start_of(const Sink& sink) {
+			if constexpr (sized<Sink>::value) {
+				return uint64_t(sink.size());
+			}
+			else {
+				return 0;
+			}
+		}
+	};
+
+	// appends records to any sink (a container, fd_sink, mapped_sink, ...), records are collected into a block until it
+	// reaches block_size and every block is written in one piece, so a crash loses at most the open block, a log may
+	// follow other bytes in a sink with size(), a log written to a stream is read from the byte where it starts
+
+	template<typename Sink>
+	class log_writer {
+	public:
+
+		log_writer(Sink& sink, size_t block_size = 0x10000) : out(sink), limit(block_size), block(block_size + 0x100), offset(record_log::start_of(sink)) {};
+		log_writer(const log_writer&) = delete;
+		log_writer& operator=(const log_writer&) = delete;
+		~log_writer() {
+			try {
+				close();
+			}
+			catch (...) { }
+		}
+
+		// packs record as the next record, timestamps are expected not to decrease (lower_bound searches them)
+		template<typename T>
+		void append(T& record, int64_t timestamp = 0) {
+			size_t start = begin_frame(timestamp);
+			pack(record, block);
+			end_frame(start);
+		}
+		// appends bytes that are already packed
+		void append_bytes(const uint8_t* src, size_t len, int64_t timestamp = 0) {
+			size_t start = begin_frame(timestamp);
+			block.push_back(reinterpret_cast<const char*>(src), uint32_t(len));
+			end_frame(start);
+		}
+		// writes the open block now, eg. before flushing the sink
+		void flush() {
+			if (pending == 0) {
+				return;
+			}
+			uint8_t header[record_log::block_header_size];
+			memcpy(header, record_log::sync_marker, 16);
+			store_d_word(header + 16, uint32_t(block.size()));
+			store_d_word(header + 20, pending);
+			store_q_word(header + 24, uint64_t(records - pending));
+			store_q_word(header + 32, uint64_t(first_timestamp));
+			uint32_t crc = crc32c(header + 16, 24);
+			crc = crc32c(block.raw_pointer(), block.size(), crc);
+			store_d_word(header + 40, crc);
+			out.push_back(reinterpret_cast<const char*>(header), uint32_t(sizeof(header)));
+			out.push_back(reinterpret_cast<const char*>(block.raw_pointer()), uint32_t(block.size()));
+			blocks.push_back({ offset, uint64_t(records - pending), first_timestamp, pending });
+			offset += sizeof(header) + block.size();
+			block.consume(block.size());
+			pending = 0;
+		}
+		// writes the open block, the index and the footer, nothing can be appended afterwards
+		void close() {
+			if (closed) {
+				return;
+			}
+			flush();
+			closed = true;
+			container index(8 + blocks.size() * record_log::index_entry_size);
+			index.push_back(uint32_t(record_log::index_magic));
+			index.push_back(uint64_t(blocks.size()));
+			for (auto& entry : blocks) {
+				index.push_back(entry.offset);
+				index.push_back(entry.first);
+				index.push_back(uint64_t(entry.timestamp));
+				index.push_back(entry.records);
+			}
+			out.push_back(reinterpret_cast<const char*>(index.raw_pointer()), uint32_t(index.size()));
+			uint8_t footer[record_log::footer_size];
+			store_q_word(footer, offset);
+			store_d_word(footer + 8, crc32c(index.raw_pointer(), index.size()));
+			store_d_word(footer + 12, uint32_t(record_log::footer_magic));
+			out.push_back(reinterpret_cast<const char*>(footer), uint32_t(sizeof(footer)));
+		}
+
+		// records appended so far
+		uint64_t size() const {
+			return records;
+		}
+
+	private:
+
+		size_t begin_frame(int64_t timestamp) {
+			if (closed) {
+				throw std::runtime_error("record log is closed!");
+			}
+			if (pending == 0) {
+				first_timestamp = timestamp;
+			}
+			size_t start = block.size();
+			block.push_back(uint32_t(0)); // length, patched by end_frame
+			block.push_back(uint64_t(timestamp));
+			return start;
+		}
+		void end_frame(size_t start) {
+			store_d_word(block.mutable_pointer(start), uint32_t(block.size() - start - record_log::frame_header_size));
+			records++;
+			pending++;
+			if (block.size() >= limit) {
+				flush();
+			}
+		}
+
+		Sink& out;
+		size_t limit;
+		container block;
+		std::vector<record_log::block_entry> blocks;
+		uint64_t offset; // of the next block in the sink
+		uint64_t records = 0;
+		uint32_t pending = 0; // records in the open block
+		int64_t first_timestamp = 0;
+		bool closed = false;
+	};
+
+	// reads a record log in place (eg. from mapped_file::bytes()), the block index comes from the footer of a closed
+	// log, otherwise the blocks are found by scanning for sync markers, skipping torn or corrupt ones (recovered())
+
+	class log_reader {
+	public:
+
+		log_reader(container& src) : log_reader(src.raw_pointer(), src.size()) {};
+		log_reader(const uint8_t* src, size_t len) : data(src), s(len) {
+			if (!load_index()) {
+				recover();
+			}
+		}
+
+		// inspection
+
+		// records in the log, including those of corrupt blocks
+		uint64_t size() const {
+			if (blocks.empty()) {
+				return 0;
+			}
+			return blocks.back().first + blocks.back().records;
+		}
+		const std::vector<record_log::block_entry>& block_index() const {
+			return blocks;
+		}
+		bool recovered() const {
+			return scanned;
+		}
+
+		// access
+
+		// packed bytes of record n, a seek through the block index, throws std::out_of_range when the block holding
+		// it was lost and std::runtime_error when its checksum does not match
+		bin_view record(uint64_t n, int64_t* timestamp = nullptr) const {
+			const record_log::block_entry& entry = block_of(n);
+			bin_view payload = verified_payload(entry);
+			uint64_t at = 0;
+			for (uint64_t i = entry.first; i < n; i++) {
+				frame(payload, at);
+			}
+			return frame(payload, at, timestamp);
+		}
+		int64_t timestamp(uint64_t n) const {
+			int64_t result = 0;
+			record(n, &result);
+			return result;
+		}
+		template<typename T>
+		void read(uint64_t n, T& dest) const {
+			bin_view bytes = record(n);
+			container src(bytes.data(), bytes.size());
+			uint64_t pos = 0;
+			unpack(dest, src, pos);
+		}
+
+		// first record with a timestamp >= timestamp (size() when none), a binary search over the blocks and a scan
+		// of one block
+		uint64_t lower_bound(int64_t timestamp) const {
+			auto after = std::partition_point(blocks.begin(), blocks.end(), [&](const record_log::block_entry& entry) {
+				return entry.timestamp < timestamp;
+			});
+			if (after == blocks.begin()) {
+				return blocks.empty() ? 0 : blocks.front().first;
+			}
+			const record_log::block_entry& entry = *(after - 1);
+			bin_view payload = verified_payload(entry);
+			uint64_t at = 0;
+			for (uint64_t i = 0; i < entry.records; i++) {
+				int64_t stamp;
+				frame(payload, at, &stamp);
+				if (stamp >= timestamp) {
+					return entry.first + i;
+				}
+			}
+			return after == blocks.end() ? size() : after->first;
+		}
+
+		// calls visit(n, timestamp, record) for the records in [first, last) that survived, record is a borrowed
+		// container to unpack from, every block is checked once
+		template<typename F>
+		void for_each(uint64_t first, uint64_t last, F visit) const {
+			auto entry = std::partition_point(blocks.begin(), blocks.end(), [&](const record_log::block_entry& e) {
+				return e.first + e.records <= first;
+			});
+			for (; entry != blocks.end() && entry->first < last; ++entry) {
+				bin_view payload = verified_payload(*entry);
+				uint64_t at = 0;
+				for (uint64_t n = entry->first; n < entry->first + entry->records && n < last; n++) {
+					int64_t stamp;
+					bin_view bytes = frame(payload, at, &stamp);
+					if (n >= first) {
+						container record(bytes.data(), bytes.size());
+						visit(n, stamp, record);
+					}
+				}
+			}
+		}
+
+	private:
+
+		const record_log::block_entry& block_of(uint64_t n) const {
+			auto after = std::partition_point(blocks.begin(), blocks.end(), [&](const record_log::block_entry& e) {
+				return e.first + e.records <= n;
+			});
+			if (after == blocks.end() || after->first > n) {
+				throw std::out_of_range("record " + std::to_string(n) + " not in the log!");
+			}
+			return *after;
+		}
+
+		// payload of a block after checking its header against the entry and its crc
+		bin_view verified_payload(const record_log::block_entry& entry) const {
+			bin_view payload;
+			if (!check_block(entry.offset, payload) || read_d_word(data + entry.offset + 20) != entry.records) {
+				throw std::runtime_error("corrupt block at " + std::to_string(entry.offset) + "!");
+			}
+			return payload;
+		}
+
+		bool check_block(uint64_t at, bin_view& payload) const {
+			if (at > s || s - at < record_log::block_header_size || memcmp(data + at, record_log::sync_marker, 16) != 0) {
+				return false;
+			}
+			uint64_t len = read_d_word(data + at + 16);
+			if (len > s - at - record_log::block_header_size) {
+				return false;
+			}
+			const uint8_t* start = data + at + record_log::block_header_size;
+			uint32_t crc = crc32c(data + at + 16, 24);
+			if (crc32c(start, size_t(len), crc) != read_d_word(data + at + 40)) {
+				return false;
+			}
+			payload = bin_view(start, size_t(len));
+			return true;
+		}
+
+		// steps at over one record of a verified payload
+		static bin_view frame(const bin_view& payload, uint64_t& at, int64_t* timestamp = nullptr) {
+			if (at + record_log::frame_header_size > payload.size()) {
+				throw std::runtime_error("record frame out of range!");
+			}
+			const uint8_t* src = payload.data() + at;
+			uint64_t len = read_d_word(src);
+			if (at + record_log::frame_header_size + len > payload.size()) {
+				throw std::runtime_error("record frame out of range!");
+			}
+			if (timestamp != nullptr) {
+				*timestamp = int64_t(read_q_word(src + 4));
+			}
+			at += record_log::frame_header_size + len;
+			return bin_view(src + record_log::frame_header_size, size_t(len));
+		}
+
+		bool load_index() {
+			if (s < record_log::footer_size) {
+				return false;
+			}
+			const uint8_t* footer = data + s - record_log::footer_size;
+			if (read_d_word(footer + 12) != record_log::footer_magic) {
+				return false;
+			}
+			uint64_t at = read_q_word(footer);
+			uint64_t end = s - record_log::footer_size;
+			if (at > end || end - at < 12 || crc32c(data + at, size_t(end - at)) != read_d_word(footer + 8) || read_d_word(data + at) != record_log::index_magic) {
+				return false;
+			}
+			uint64_t n = read_q_word(data + at + 4);
+			if (n != (end - at - 12) / record_log::index_entry_size) {
+				return false;
+			}
+			blocks.resize(size_t(n));
+			const uint8_t* entry = data + at + 12;
+			for (auto& b : blocks) {
+				b = { read_q_word(entry), read_q_word(entry + 8), int64_t(read_q_word(entry + 16)), read_d_word(entry + 24) };
+				entry += record_log::index_entry_size;
+			}
+			return true;
+		}
+
+		// rebuilds the index from the blocks themselves, anything between intact blocks is skipped up to the next
+		// sync marker
+		void recover() {
+			scanned = true;
+			blocks.clear();
+			std::string_view bytes(reinterpret_cast<const char*>(data), s);
+			std::string_view marker(reinterpret_cast<const char*>(record_log::sync_marker), 16);
+			uint64_t at = 0;
+			while (true) {
+				size_t found = bytes.find(marker, size_t(at));
+				if (found == std::string_view::npos) {
+					return;
+				}
+				at = found;
+				bin_view payload;
+				if (check_block(at, payload)) {
+					const uint8_t* header = data + at;
+					blocks.push_back({ at, read_q_word(header + 24), int64_t(read_q_word(header + 32)), read_d_word(header + 20) });
+					at += record_log::block_header_size + payload.size();
+				}
+				else {
+					at++;
+				}
+			}
+		}
+
+		const uint8_t* data;
+		size_t s;
+		std::vector<record_log::block_entry> blocks;
+		bool scanned = false;
+	};
+};
+
+#endif
@@ -0,0 +1,518 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include "containers/byte.hpp"
+#include "formats.hpp"
+
+#if !defined(no_simd) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define msgpack_simd_x86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define msgpack_target(isa) __attribute__((target(isa)))
+#else
+#define msgpack_target(isa)
+#endif
+
+namespace msgpack {
+	// bulk kernels for contiguous arithmetic arrays, they only handle blocks where every element shares an encoding and
+	// return how many elements they consumed, msgpack::pack_bulk / unpack_bulk fall back to the scalar overloads for the rest
+
+	namespace simd {
+		enum class isa : uint8_t {
+			scalar,
+			sse42,
+			avx2
+		};
+
+		inline isa detect() {
+#ifdef msgpack_simd_x86
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 1);
+			bool sse42 = (info[2] & (1 << 20)) != 0;
+			bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+			__cpuidex(info, 7, 0);
+			bool avx2 = avx && (info[1] & (1 << 5)) != 0;
+#else
+			__builtin_cpu_init();
+			bool sse42 = __builtin_cpu_supports("sse4.2");
+			bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+			if (avx2) {
+				return isa::avx2;
+			}
+			if (sse42) {
+				return isa::sse42;
+			}
+#endif
+			return isa::scalar;
+		}
+
+		// instruction set used by the kernels, detected once, can be lowered to compare against the scalar path
+		inline isa& level() {
+			static isa active = detect();
+			return active;
+		}
+
+		// element types routed through the bulk kernels (bool and char keep their own encodings)
+		template<typename T>
+		struct bulk : std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value> {};
+
+		// elements the encoder handles per block, the caller packs this many with the scalar path when a block is mixed
+		template<typename T>
+		size_t block_size() {
+			bool wide = sizeof(T) == 8;
+			bool covered = sizeof(T) >= 4;
+			switch (level()) {
+			case isa::avx2: {
+				return covered ? (wide ? 4 : 8) : SIZE_MAX;
+			}
+			case isa::sse42: {
+				return covered ? (wide ? 2 : 4) : SIZE_MAX;
+			}
+			default: {
+				return SIZE_MAX;
+			}
+			}
+		}
+
+		inline unsigned trailing_zeros(uint32_t mask) {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return unsigned(index);
+#else
+			return unsigned(__builtin_ctz(mask));
+#endif
+		}
+
+#ifdef msgpack_simd_x86
+		// building blocks
+
+		// 4 native dwords -> 3 [header, big endian dword] records in 16 bytes plus the header of the fourth record
+		msgpack_target("sse4.2") inline void store_records5(uint8_t* out, __m128i v, uint8_t header) {
+			const __m128i order = _mm_setr_epi8(-128, 3, 2, 1, 0, -128, 7, 6, 5, 4, -128, 11, 10, 9, 8, -128);
+			const __m128i headers = _mm_setr_epi8(char(header), 0, 0, 0, 0, char(header), 0, 0, 0, 0, char(header), 0, 0, 0, 0, char(header));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_or_si128(_mm_shuffle_epi8(v, order), headers));
+		}
+
+		// 2 native qwords -> 2 [header, big endian qword] records
+		msgpack_target("sse4.2") inline void store_records9(uint8_t* out, __m128i v, uint8_t header) {
+			const __m128i order = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+			__m128i swapped = _mm_shuffle_epi8(v, order);
+			out[0] = header;
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out + 1), swapped);
+			out[9] = header;
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out + 10), _mm_unpackhi_epi64(swapped, swapped));
+		}
+
+		// encoders, out needs 16 bytes of slack past the encoded size
+
+		template<bool Signed>
+		msgpack_target("sse4.2") size_t encode_d_words_sse42(const uint32_t* src, size_t n, uint8_t*& out) {
+			const __m128i low = _mm_setr_epi8(0, 4, 8, 12, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				__m128i fix, wide;
+				if (Signed) {
+					fix = _mm_and_si128(_mm_cmpgt_epi32(v, _mm_set1_epi32(-33)), _mm_cmplt_epi32(v, _mm_set1_epi32(128)));
+					wide = _mm_or_si128(_mm_cmplt_epi32(v, _mm_set1_epi32(-32768)), _mm_cmpgt_epi32(v, _mm_set1_epi32(32767)));
+				}
+				else {
+					fix = _mm_cmpeq_epi32(_mm_min_epu32(v, _mm_set1_epi32(posmax8)), v);
+					wide = _mm_cmpeq_epi32(_mm_max_epu32(v, _mm_set1_epi32(umax16 + 1)), v);
+				}
+				if (_mm_movemask_ps(_mm_castsi128_ps(fix)) == 0xF) {
+					int32_t bytes = _mm_cvtsi128_si32(_mm_shuffle_epi8(v, low));
+					memcpy(out, &bytes, 4);
+					out += 4;
+				}
+				else if (_mm_movemask_ps(_mm_castsi128_ps(wide)) == 0xF) {
+					store_records5(out, v, Signed ? int32 : uint32);
+					msgpack_byte::store_d_word(out + 16, src[i + 3]);
+					out += 20;
+				}
+				else {
+					break;
+				}
+			}
+			return i;
+		}
+
+		template<bool Signed>
+		msgpack_target("avx2") size_t encode_d_words_avx2(const uint32_t* src, size_t n, uint8_t*& out) {
+			const __m256i low = _mm256_setr_epi8(0, 4, 8, 12, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128,
+				0, 4, 8, 12, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+			const __m256i gather = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+				__m256i fix, wide;
+				if (Signed) {
+					fix = _mm256_and_si256(_mm256_cmpgt_epi32(v, _mm256_set1_epi32(-33)), _mm256_cmpgt_epi32(_mm256_set1_epi32(128), v));
+					wide = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(-32768), v), _mm256_cmpgt_epi32(v, _mm256_set1_epi32(32767)));
+				}
+				else {
+					fix = _mm256_cmpeq_epi32(_mm256_min_epu32(v, _mm256_set1_epi32(posmax8)), v);
+					wide = _mm256_cmpeq_epi32(_mm256_max_epu32(v, _mm256_set1_epi32(umax16 + 1)), v);
+				}
+				if (_mm256_movemask_ps(_mm256_castsi256_ps(fix)) == 0xFF) {
+					__m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, low), gather);
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(bytes));
+					out += 8;
+				}
+				else if (_mm256_movemask_ps(_mm256_castsi256_ps(wide)) == 0xFF) {
+					uint8_t header = Signed ? int32 : uint32;
+					store_records5(out, _mm256_castsi256_si128(v), header);
+					msgpack_byte::store_d_word(out + 16, src[i + 3]);
+					store_records5(out + 20, _mm256_extracti128_si256(v, 1), header);
+					msgpack_byte::store_d_word(out + 36, src[i + 7]);
+					out += 40;
+				}
+				else {
+					break;
+				}
+			}
+			return i;
+		}
+
+		template<bool Signed>
+		msgpack_target("sse4.2") size_t encode_q_words_sse42(const uint64_t* src, size_t n, uint8_t*& out) {
+			const __m128i low = _mm_setr_epi8(0, 8, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+			const __m128i zero = _mm_setzero_si128();
+			size_t i = 0;
+			for (; i + 2 <= n; i += 2) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				__m128i fix, mid, wide;
+				if (Signed) {
+					fix = _mm_and_si128(_mm_cmpgt_epi64(v, _mm_set1_epi64x(-33)), _mm_cmpgt_epi64(_mm_set1_epi64x(128), v));
+					mid = _mm_or_si128(_mm_cmpgt_epi64(_mm_set1_epi64x(-32768), v), _mm_cmpgt_epi64(v, _mm_set1_epi64x(32767)));
+					wide = _mm_or_si128(_mm_cmpgt_epi64(_mm_set1_epi64x(INT32_MIN), v), _mm_cmpgt_epi64(v, _mm_set1_epi64x(INT32_MAX)));
+				}
+				else {
+					fix = _mm_cmpeq_epi64(_mm_srli_epi64(v, 7), zero);
+					mid = _mm_xor_si128(_mm_cmpeq_epi64(_mm_srli_epi64(v, 16), zero), _mm_set1_epi32(-1));
+					wide = _mm_xor_si128(_mm_cmpeq_epi64(_mm_srli_epi64(v, 32), zero), _mm_set1_epi32(-1));
+				}
+				int wide_mask = _mm_movemask_pd(_mm_castsi128_pd(wide));
+				if (_mm_movemask_pd(_mm_castsi128_pd(fix)) == 0x3) {
+					uint16_t bytes = uint16_t(_mm_extract_epi16(_mm_shuffle_epi8(v, low), 0));
+					memcpy(out, &bytes, 2);
+					out += 2;
+				}
+				else if (wide_mask == 0x3) {
+					store_records9(out, v, Signed ? int64 : uint64);
+					out += 18;
+				}
+				else if (wide_mask == 0 && _mm_movemask_pd(_mm_castsi128_pd(mid)) == 0x3) {
+					// 32 bit wide values, the low dwords go out as int32 / uint32 records
+					store_records5(out, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 0, 2, 0)), Signed ? int32 : uint32);
+					out += 10;
+				}
+				else {
+					break;
+				}
+			}
+			return i;
+		}
+
+		template<bool Signed>
+		msgpack_target("avx2") size_t encode_q_words_avx2(const uint64_t* src, size_t n, uint8_t*& out) {
+			const __m256i low = _mm256_setr_epi8(0, 8, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128,
+				0, 8, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+			const __m256i zero = _mm256_setzero_si256();
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+				__m256i fix, mid, wide;
+				if (Signed) {
+					fix = _mm256_and_si256(_mm256_cmpgt_epi64(v, _mm256_set1_epi64x(-33)), _mm256_cmpgt_epi64(_mm256_set1_epi64x(128), v));
+					mid = _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_set1_epi64x(-32768), v), _mm256_cmpgt_epi64(v, _mm256_set1_epi64x(32767)));
+					wide = _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_set1_epi64x(INT32_MIN), v), _mm256_cmpgt_epi64(v, _mm256_set1_epi64x(INT32_MAX)));
+				}
+				else {
+					fix = _mm256_cmpeq_epi64(_mm256_srli_epi64(v, 7), zero);
+					mid = _mm256_xor_si256(_mm256_cmpeq_epi64(_mm256_srli_epi64(v, 16), zero), _mm256_set1_epi32(-1));
+					wide = _mm256_xor_si256(_mm256_cmpeq_epi64(_mm256_srli_epi64(v, 32), zero), _mm256_set1_epi32(-1));
+				}
+				int wide_mask = _mm256_movemask_pd(_mm256_castsi256_pd(wide));
+				if (_mm256_movemask_pd(_mm256_castsi256_pd(fix)) == 0xF) {
+					__m256i bytes = _mm256_shuffle_epi8(v, low);
+					uint16_t first = uint16_t(_mm256_extract_epi16(bytes, 0));
+					uint16_t second = uint16_t(_mm256_extract_epi16(bytes, 8));
+					memcpy(out, &first, 2);
+					memcpy(out + 2, &second, 2);
+					out += 4;
+				}
+				else if (wide_mask == 0xF) {
+					uint8_t header = Signed ? int64 : uint64;
+					store_records9(out, _mm256_castsi256_si128(v), header);
+					store_records9(out + 18, _mm256_extracti128_si256(v, 1), header);
+					out += 36;
+				}
+				else if (wide_mask == 0 && _mm256_movemask_pd(_mm256_castsi256_pd(mid)) == 0xF) {
+					// 32 bit wide values, the low dwords go out as int32 / uint32 records
+					__m128i narrow = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0)));
+					store_records5(out, narrow, Signed ? int32 : uint32);
+					msgpack_byte::store_d_word(out + 16, uint32_t(src[i + 3]));
+					out += 20;
+				}
+				else {
+					break;
+				}
+			}
+			return i;
+		}
+
+		msgpack_target("sse4.2") inline size_t encode_floats_sse42(const float* src, size_t n, uint8_t*& out) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				store_records5(out, _mm_castps_si128(_mm_loadu_ps(src + i)), float32);
+				msgpack_byte::store_d_word(out + 16, src[i + 3]);
+				out += 20;
+			}
+			return i;
+		}
+
+		msgpack_target("avx2") inline size_t encode_floats_avx2(const float* src, size_t n, uint8_t*& out) {
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256i v = _mm256_castps_si256(_mm256_loadu_ps(src + i));
+				store_records5(out, _mm256_castsi256_si128(v), float32);
+				msgpack_byte::store_d_word(out + 16, src[i + 3]);
+				store_records5(out + 20, _mm256_extracti128_si256(v, 1), float32);
+				msgpack_byte::store_d_word(out + 36, src[i + 7]);
+				out += 40;
+			}
+			return i;
+		}
+
+		// doubles that survive a round trip through float are packed as float32, like pack(const double&)
+		msgpack_target("sse4.2") inline size_t encode_doubles_sse42(const double* src, size_t n, uint8_t*& out) {
+			size_t i = 0;
+			for (; i + 2 <= n; i += 2) {
+				__m128d v = _mm_loadu_pd(src + i);
+				__m128 narrow = _mm_cvtpd_ps(v);
+				int exact = _mm_movemask_pd(_mm_cmpeq_pd(_mm_cvtps_pd(narrow), v));
+				if (exact == 0x3) {
+					store_records5(out, _mm_castps_si128(narrow), float32);
+					out += 10;
+				}
+				else if (exact == 0) {
+					store_records9(out, _mm_castpd_si128(v), float64);
+					out += 18;
+				}
+				else {
+					break;
+				}
+			}
+			return i;
+		}
+
+		msgpack_target("avx2") inline size_t encode_doubles_avx2(const double* src, size_t n, uint8_t*& out) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				__m256d v = _mm256_loadu_pd(src + i);
+				__m128 narrow = _mm256_cvtpd_ps(v);
+				int exact = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_cvtps_pd(narrow), v, _CMP_EQ_OQ));
+				if (exact == 0xF) {
+					__m128i bits = _mm_castps_si128(narrow);
+					store_records5(out, bits, float32);
+					msgpack_byte::store_d_word(out + 16, uint32_t(_mm_extract_epi32(bits, 3)));
+					out += 20;
+				}
+				else if (exact == 0) {
+					store_records9(out, _mm256_castsi256_si128(_mm256_castpd_si256(v)), float64);
+					store_records9(out + 18, _mm256_extracti128_si256(_mm256_castpd_si256(v), 1), float64);
+					out += 36;
+				}
+				else {
+					break;
+				}
+			}
+			return i;
+		}
+
+		// decoders
+
+		// leading bytes of p[0, len) that are positive or negative fixints
+		msgpack_target("sse4.2") inline size_t fixint_run_sse42(const uint8_t* p, size_t len, size_t max) {
+			const __m128i limit = _mm_set1_epi8(-33);
+			size_t run = 0;
+			while (run < max && run + 16 <= len) {
+				uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + run)), limit)));
+				if (mask != 0xFFFF) {
+					run += trailing_zeros(~mask);
+					break;
+				}
+				run += 16;
+			}
+			return run < max ? run : max;
+		}
+
+		msgpack_target("avx2") inline size_t fixint_run_avx2(const uint8_t* p, size_t len, size_t max) {
+			const __m256i limit = _mm256_set1_epi8(-33);
+			size_t run = 0;
+			while (run < max && run + 32 <= len) {
+				uint32_t mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + run)), limit)));
+				if (mask != 0xFFFFFFFF) {
+					run += trailing_zeros(~mask);
+					break;
+				}
+				run += 32;
+			}
+			return run < max ? run : max;
+		}
+
+		// three [header, big endian dword] records starting at p, returned as native dwords in lanes 0-2
+		msgpack_target("sse4.2") inline __m128i load_records5(const uint8_t* p) {
+			const __m128i order = _mm_setr_epi8(3, 2, 1, 0, 8, 7, 6, 5, 13, 12, 11, 10, -128, -128, -128, -128);
+			return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1)), order);
+		}
+
+		// two [header, big endian qword] records starting at p, returned as native qwords
+		msgpack_target("sse4.2") inline __m128i load_records9(const uint8_t* p) {
+			const __m128i order = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+			__m128i v = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 1)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 10)));
+			return _mm_shuffle_epi8(v, order);
+		}
+
+		template<typename T>
+		T from_d_word(uint32_t bits, uint8_t header) {
+			if (header == float32) {
+				float value;
+				memcpy(&value, &bits, 4);
+				return T(value);
+			}
+			return header == int32 ? T(int32_t(bits)) : T(bits);
+		}
+
+		template<typename T>
+		T from_q_word(uint64_t bits, uint8_t header) {
+			if (header == float64) {
+				double value;
+				memcpy(&value, &bits, 8);
+				return T(value);
+			}
+			return header == int64 ? T(int64_t(bits)) : T(bits);
+		}
+
+		// whether a record header decodes into T the same way the scalar unpack overloads do
+		template<typename T>
+		bool accepts(uint8_t header) {
+			if constexpr (std::is_same<T, float>::value) {
+				return header == float32;
+			}
+			else if constexpr (std::is_same<T, double>::value) {
+				return header == float32 || header == float64;
+			}
+			else if constexpr (sizeof(T) >= 4) {
+				return header == int32 || header == uint32 || (sizeof(T) == 8 && (header == int64 || header == uint64));
+			}
+			return false;
+		}
+
+		template<typename T>
+		msgpack_target("sse4.2") size_t decode_sse42(T* dest, size_t n, const uint8_t* data, size_t len, uint64_t& pos, bool avx2) {
+			size_t i = 0;
+			while (i < n && pos < len) {
+				const uint8_t* p = data + pos;
+				size_t avail = len - pos;
+				if constexpr (std::is_integral<T>::value) {
+					size_t run = avx2 ? fixint_run_avx2(p, avail, n - i) : fixint_run_sse42(p, avail, n - i);
+					if (run > 0) {
+						for (size_t j = 0; j < run; j++) {
+							dest[i + j] = T(int8_t(p[j]));
+						}
+						i += run;
+						pos += run;
+						continue;
+					}
+				}
+				uint8_t header = p[0];
+				if (!accepts<T>(header)) {
+					break;
+				}
+				if (header == float64 || header == int64 || header == uint64) {
+					if (n - i < 2 || avail < 18 || p[9] != header) {
+						break;
+					}
+					uint64_t values[2];
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(values), load_records9(p));
+					dest[i] = from_q_word<T>(values[0], header);
+					dest[i + 1] = from_q_word<T>(values[1], header);
+					i += 2;
+					pos += 18;
+				}
+				else {
+					if (n - i < 3 || avail < 17 || p[5] != header || p[10] != header) {
+						break;
+					}
+					uint32_t values[4];
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(values), load_records5(p));
+					dest[i] = from_d_word<T>(values[0], header);
+					dest[i + 1] = from_d_word<T>(values[1], header);
+					dest[i + 2] = from_d_word<T>(values[2], header);
+					i += 3;
+					pos += 15;
+				}
+			}
+			return i;
+		}
+#endif
+
+		// dispatch
+
+		// encodes a prefix of src into out (advanced past it), out needs packed size + 16 bytes
+		template<typename T>
+		size_t encode(const T* src, size_t n, uint8_t*& out) {
+#ifdef msgpack_simd_x86
+			isa active = level();
+			if (active == isa::scalar) {
+				return 0;
+			}
+			bool avx2 = active == isa::avx2;
+			if constexpr (std::is_same<T, float>::value) {
+				return avx2 ? encode_floats_avx2(src, n, out) : encode_floats_sse42(src, n, out);
+			}
+			else if constexpr (std::is_same<T, double>::value) {
+				return avx2 ? encode_doubles_avx2(src, n, out) : encode_doubles_sse42(src, n, out);
+			}
+			else if constexpr (std::is_integral<T>::value && sizeof(T) == 4) {
+				const uint32_t* bits = reinterpret_cast<const uint32_t*>(src);
+				return avx2 ? encode_d_words_avx2<std::is_signed<T>::value>(bits, n, out) : encode_d_words_sse42<std::is_signed<T>::value>(bits, n, out);
+			}
+			else if constexpr (std::is_integral<T>::value && sizeof(T) == 8) {
+				const uint64_t* bits = reinterpret_cast<const uint64_t*>(src);
+				return avx2 ? encode_q_words_avx2<std::is_signed<T>::value>(bits, n, out) : encode_q_words_sse42<std::is_signed<T>::value>(bits, n, out);
+			}
+#endif
+			return 0;
+		}
+
+		// decodes runs of fixints and same-header records at data[pos], returns the elements written to dest
+		template<typename T>
+		size_t decode(T* dest, size_t n, const uint8_t* data, size_t len, uint64_t& pos) {
+#ifdef msgpack_simd_x86
+			isa active = level();
+			if (active != isa::scalar) {
+				return decode_sse42(dest, n, data, len, pos, active == isa::avx2);
+			}
+#endif
+			return 0;
+		}
+	};
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+
+#include "msgpack.hpp"
+#include "view.hpp"
+
+namespace msgpack {
+	// decodes a byte stream that arrives in arbitrary fragments (eg. from a socket): every chunk is appended to an
+	// internal buffer and the structural scan resumes where the previous chunk ended, so nothing is scanned twice and
+	// each top-level object is ready as soon as its last byte has arrived
+
+	class stream_unpacker {
+	public:
+
+		stream_unpacker(size_t reserve = 0x10000) : buffer(reserve) {};
+
+		// input
+
+		void feed(const uint8_t* src, size_t len) {
+			memcpy(prepare(len), src, len);
+			commit(len);
+		}
+		void feed(const char* src, size_t len) {
+			feed(reinterpret_cast<const uint8_t*>(src), len);
+		}
+		// room for bytes more bytes written in place, eg. commit(read(fd, unpacker.prepare(0x10000), 0x10000))
+		uint8_t* prepare(size_t bytes) {
+			compact();
+			buffer.check_resize(bytes);
+			return buffer.mutable_pointer(buffer.size());
+		}
+		// scans the bytes written after prepare, throws std::invalid_argument on bytes that are not msgpack
+		void commit(size_t bytes) {
+			buffer.commit(bytes);
+			scan();
+		}
+
+		// output
+
+		// complete top-level objects waiting to be unpacked
+		size_t ready() const {
+			return ends.size();
+		}
+		// unpacks the next complete object into dest, false when none is ready yet, string views and other zero-copy
+		// targets point into the internal buffer and stay valid until the next feed or prepare
+		template<typename T>
+		bool next(T& dest) {
+			if (ends.empty()) {
+				return false;
+			}
+			uint64_t pos = head;
+			unpack(dest, buffer, pos);
+			head = ends.front();
+			ends.pop_front();
+			return true;
+		}
+		bool next(view& dest) {
+			if (ends.empty()) {
+				return false;
+			}
+			dest = view(buffer.raw_pointer(), size_t(ends.front()), head);
+			head = ends.front();
+			ends.pop_front();
+			return true;
+		}
+		// bytes received but not handed out yet, the incomplete object included
+		size_t buffered() const {
+			return size_t(buffer.size() - head);
+		}
+		// drops everything buffered, eg. to resynchronise after invalid input
+		void reset() {
+			buffer.consume(buffer.size());
+			head = 0;
+			cursor = 0;
+			pending = 0;
+			partial = false;
+			ends.clear();
+		}
+
+	private:
+
+		// resumes the scan at cursor with the elements still missing from the current object
+		void scan() {
+			const uint8_t* data = buffer.raw_pointer();
+			size_t len = buffer.size();
+			while (true) {
+				if (pending == 0) {
+					if (cursor > len) {
+						return; // the payload of the last element is still arriving
+					}
+					if (partial) {
+						ends.push_back(cursor);
+						partial = false;
+					}
+					if (cursor == len) {
+						return;
+					}
+					pending = 1;
+					partial = true;
+				}
+				if (!skip_header(data, len, cursor, pending)) {
+					return;
+				}
+			}
+		}
+
+		// unpacked objects are dropped before the buffer would grow, so it stays about as large as the unread bytes
+		void compact() {
+			if (head == 0) {
+				return;
+			}
+			buffer.consume(size_t(head));
+			cursor -= head;
+			for (auto& end : ends) {
+				end -= head;
+			}
+			head = 0;
+		}
+
+		container buffer;
+		uint64_t head = 0;    // start of the next ready object
+		uint64_t cursor = 0;  // scan position, may run past the buffer while a payload is arriving
+		uint64_t pending = 0; // elements still missing from the object being scanned
+		bool partial = false; // an object is being scanned
+		std::deque<uint64_t> ends;
+	};
+};
+
+#endif
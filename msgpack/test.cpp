@@ -4,11 +4,21 @@
 #include <tuple>
 #include <random>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <type_traits>
 
 #include "msgpack.hpp"
+#include "parallel.hpp"
+#include "view.hpp"
+#include "stream.hpp"
+#include "visitor.hpp"
+#include "object.hpp"
+#include "record_log.hpp"
+#include "compress.hpp"
+#include "containers/mapped.hpp"
+#include "allocation_counter.hpp"
 
 using namespace std;
 
@@ -25,6 +35,54 @@ using namespace std;
 #define minfloat -1e-38
 #define constfloat 1e-38;
 
+// whether f throws E, for the truncated and corrupt input checks
+template<typename E, typename F>
+bool throws(F f) {
+	try {
+		f();
+	}
+	catch (const E&) {
+		return true;
+	}
+	return false;
+}
+
+// user defined structures for the reflection checks, one packed as an array and one as a map keyed by field names
+struct sample_point {
+	int x = 0;
+	string label;
+	vector<double> weights;
+	msgpack_define(x, label, weights)
+};
+
+struct sample_record {
+	int id = 0;
+	string name;
+	msgpack_define_map(id, name)
+};
+
+// counts what msgpack::parse reports, for the visitor checks
+struct counting_visitor : msgpack::visitor {
+	size_t ints = 0, strings = 0, string_bytes = 0, opened = 0, closed = 0;
+
+	void on_uint(uint64_t) { ints++; }
+	void on_int(int64_t) { ints++; }
+	void on_str(std::string_view value) { strings++; string_bytes += value.size(); }
+	void on_array_begin(size_t) { opened++; }
+	void on_map_begin(size_t) { opened++; }
+	void on_array_end() { closed++; }
+	void on_map_end() { closed++; }
+};
+
+template<typename T>
+uint64_t count_unpack_allocations(T& dest, msgpack_byte::container& src) {
+	allocations = 0;
+	counting_allocations = true;
+	msgpack::unpack(dest, src);
+	counting_allocations = false;
+	return allocations;
+}
+
 char current_char = minchar;
 int current_int = minint;
 double current_double = mindouble;
@@ -115,5 +173,346 @@ int main() {
 	auto end_pack = chrono::high_resolution_clock::now();
 	std::cout << dest.size() << " bytes " << (double)(dest.size() / 1e6) << "MB packed size in " << double(chrono::duration_cast<chrono::milliseconds>(end_pack - start_pack).count()) << " milliseconds" << endl;
 	std::cout << "Packing efficiency: " << (double)((double)dest.size() / (double)total_bytes) * (double)100 << "%" << std::endl;
+
+	// exact pre-sizing against the LengthOf * compression_percent heuristic above
+	msgpack_byte::container exact_dest;
+	auto start_size = chrono::high_resolution_clock::now();
+	size_t exact_size = msgpack::packed_size(test_vector);
+	auto end_size = chrono::high_resolution_clock::now();
+	auto start_exact = chrono::high_resolution_clock::now();
+	msgpack::pack_exact(test_vector, exact_dest);
+	auto end_exact = chrono::high_resolution_clock::now();
+	std::cout << exact_size << " bytes exact size computed in " << double(chrono::duration_cast<chrono::milliseconds>(end_size - start_size).count()) << " milliseconds, packed in " << double(chrono::duration_cast<chrono::milliseconds>(end_exact - start_exact).count()) << " milliseconds" << endl;
+	std::cout << "Capacity: heuristic " << dest.capacity() << " bytes, exact " << exact_dest.capacity() << " bytes" << endl;
+
+	// parallel packing from one worker up to one per hardware thread
+	unsigned max_threads = msgpack::parallel_threads();
+	double single_thread = 0;
+	for (unsigned threads = 1; ; threads = std::min(threads * 2, max_threads)) {
+		msgpack_byte::container parallel_dest;
+		auto start_parallel = chrono::high_resolution_clock::now();
+		msgpack::parallel_pack(test_vector, parallel_dest, threads);
+		auto end_parallel = chrono::high_resolution_clock::now();
+		double elapsed = double(chrono::duration_cast<chrono::milliseconds>(end_parallel - start_parallel).count());
+		if (threads == 1) {
+			single_thread = elapsed;
+		}
+		std::cout << threads << " threads packed in " << elapsed << " milliseconds, speedup " << (elapsed > 0 ? single_thread / elapsed : 1) << "x" << (parallel_dest == dest ? "" : " (output differs!)") << endl;
+		if (threads == max_threads) {
+			break;
+		}
+	}
+
+	// sequential unpacking against parallel unpacking from one worker up to one per hardware thread
+	auto start_unpack = chrono::high_resolution_clock::now();
+	decltype(test_vector) unpacked;
+	msgpack::unpack(unpacked, dest);
+	auto end_unpack = chrono::high_resolution_clock::now();
+	double sequential = double(chrono::duration_cast<chrono::milliseconds>(end_unpack - start_unpack).count());
+	std::cout << "Sequentially unpacked in " << sequential << " milliseconds" << (unpacked == test_vector ? "" : " (output differs!)") << endl;
+	for (unsigned threads = 1; ; threads = std::min(threads * 2, max_threads)) {
+		decltype(test_vector) parallel_unpacked;
+		auto start_parallel = chrono::high_resolution_clock::now();
+		msgpack::parallel_unpack(parallel_unpacked, dest, threads);
+		auto end_parallel = chrono::high_resolution_clock::now();
+		double elapsed = double(chrono::duration_cast<chrono::milliseconds>(end_parallel - start_parallel).count());
+		std::cout << threads << " threads unpacked in " << elapsed << " milliseconds, speedup " << (elapsed > 0 ? sequential / elapsed : 1) << "x" << (parallel_unpacked == test_vector ? "" : " (output differs!)") << endl;
+		if (threads == max_threads) {
+			break;
+		}
+	}
+
+	// decoding the same data again into the already filled destination reuses its storage, after the warm-up above
+	// this should not allocate at all
+	auto start_reuse = chrono::high_resolution_clock::now();
+	uint64_t reuse_allocations = count_unpack_allocations(unpacked, dest);
+	auto end_reuse = chrono::high_resolution_clock::now();
+	std::cout << "Steady state unpacked in " << double(chrono::duration_cast<chrono::milliseconds>(end_reuse - start_reuse).count()) << " milliseconds with " << reuse_allocations << " allocations (0 expected)" << (unpacked == test_vector ? "" : " (output differs!)") << endl;
+
+	// allocations per decoded element, strings are longer than the small string buffer so each one needs exactly one
+	const size_t elements = 10000;
+	vector<string> strings(elements, string(40, 'x'));
+	map<int, string> string_map;
+	list<string> string_list(elements, string(40, 'y'));
+	for (size_t i = 0; i < elements; i++) {
+		string_map.emplace(int(i), string(40, 'z'));
+	}
+	msgpack_byte::container packed_strings, packed_map, packed_list;
+	msgpack::pack(strings, packed_strings);
+	msgpack::pack(string_map, packed_map);
+	msgpack::pack(string_list, packed_list);
+	vector<string> unpacked_strings;
+	map<int, string> unpacked_map;
+	list<string> unpacked_list;
+	std::cout << "Allocations per element: vector<string> " << double(count_unpack_allocations(unpacked_strings, packed_strings)) / elements
+		<< " (1 expected), map<int, string> " << double(count_unpack_allocations(unpacked_map, packed_map)) / elements
+		<< " (2 expected), list<string> " << double(count_unpack_allocations(unpacked_list, packed_list)) / elements << " (2 expected)" << endl;
+
+	// a position inside the payload of a validated value is not a value start, its str32 header claims 2 GB past the end
+	msgpack_byte::container inside_payload;
+	msgpack::pack(string("\xdb\x7f\xff\xff\xff"), inside_payload);
+	string whole, inner;
+	uint64_t start = 0;
+	msgpack::unpack(whole, inside_payload, start);
+	uint64_t inside = 1;
+	bool rejected = false;
+	try {
+		msgpack::unpack(inner, inside_payload, inside);
+	}
+	catch (const std::out_of_range&) {
+		rejected = true;
+	}
+	std::cout << "Decoding inside a validated payload " << (rejected ? "rejected" : "accepted (out of bounds!)") << " (rejected expected)" << endl;
+
+	// view: lazy access into packed bytes, payloads past the end of the buffer are rejected
+	map<string, vector<int>> view_source{ { "a", { 1, 2, 3 } }, { "b", { 4 } } };
+	msgpack_byte::container view_packed;
+	msgpack::pack(view_source, view_packed);
+	msgpack::view packed_view(view_packed);
+	bool view_ok = packed_view.size() == 2 && packed_view["a"][2].as<int>() == 3 && packed_view["b"].size() == 1 && !packed_view.contains("c");
+	const uint8_t short_str[] = { 0xbf, 0x61 }; // fixstr of 31 bytes holding 1
+	const uint8_t short_double[] = { 0xcb, 0x00, 0x00 };
+	const uint8_t short_array[] = { 0x93, 0x01 };
+	view_ok = view_ok && throws<std::out_of_range>([&] { msgpack::view(short_str, sizeof(short_str)).as_string(); })
+		&& throws<std::out_of_range>([&] { msgpack::view(short_double, sizeof(short_double)).as_double(); })
+		&& throws<std::out_of_range>([&] { msgpack::view(short_array, sizeof(short_array))[2]; });
+	std::cout << "View: " << (view_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// typed arrays: one ext record per arithmetic vector, read back with a memcpy, a conversion or in place
+	vector<int32_t> typed_source{ 1, -2, 70000, -2147483647 - 1 };
+	msgpack_byte::container typed_packed;
+	{
+		msgpack::typed_arrays_scope typed(true);
+		msgpack::pack(typed_source, typed_packed);
+	}
+	vector<int32_t> typed_same;
+	vector<int64_t> typed_wider;
+	msgpack::typed_array_view<int32_t> typed_view;
+	uint64_t typed_pos = 0;
+	msgpack::unpack(typed_same, typed_packed);
+	msgpack::unpack(typed_wider, typed_packed);
+	msgpack::unpack(typed_view, typed_packed, typed_pos);
+	bool typed_ok = typed_same == typed_source && typed_wider == vector<int64_t>(typed_source.begin(), typed_source.end())
+		&& typed_view.size() == 4 && typed_view[2] == 70000 && typed_pos == typed_packed.size();
+	msgpack_byte::container typed_short(typed_packed.raw_pointer(), typed_packed.size() - 1);
+	msgpack_byte::container typed_bad_kind = typed_packed;
+	typed_bad_kind[3] = 0xff; // element kind behind the ext type
+	typed_ok = typed_ok && throws<std::out_of_range>([&] { vector<int32_t> out; msgpack::unpack(out, typed_short); })
+		&& throws<std::invalid_argument>([&] { vector<int32_t> out; msgpack::unpack(out, typed_bad_kind); });
+	std::cout << "Typed arrays: " << (typed_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// skip and build_index: offsets of whole values without decoding them
+	tuple<vector<string>, map<int, int>, int> index_source{ { "a", string(300, 'b') }, { { 1, 2 }, { 3, 4 } }, 5 };
+	msgpack_byte::container index_packed;
+	msgpack::pack(index_source, index_packed);
+	msgpack::offset_index top = msgpack::build_index(index_packed);
+	msgpack::offset_index entries = msgpack::build_index(index_packed, top[1]);
+	uint64_t skipped = top[0];
+	msgpack::skip(index_packed, skipped);
+	int entry_value = 0, last = 0;
+	uint64_t entry_pos = entries.value(1), last_pos = top[2];
+	msgpack::unpack(entry_value, index_packed, entry_pos);
+	msgpack::unpack(last, index_packed, last_pos);
+	bool index_ok = top.size() == 3 && !top.pairs && entries.size() == 2 && entries.pairs && skipped == top[1] && top.end() == index_packed.size()
+		&& entry_value == 4 && last == 5;
+	msgpack_byte::container index_short(index_packed.raw_pointer(), index_packed.size() - 1);
+	index_ok = index_ok && throws<std::out_of_range>([&] { msgpack::build_index(index_short); })
+		&& throws<std::out_of_range>([&] { uint64_t pos = top[0]; msgpack::skip(index_short.raw_pointer(), top[1] - 1, pos); })
+		&& throws<std::invalid_argument>([&] { msgpack::build_index(index_packed, top[2]); });
+	std::cout << "Skip and index: " << (index_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// packed_map_index: hashed key lookups in a packed map without unpacking it
+	map<string, vector<int>> keyed_source;
+	for (int i = 0; i < 100; i++) {
+		keyed_source["key_" + to_string(i)] = vector<int>(size_t(i % 3), i);
+	}
+	msgpack_byte::container keyed_packed;
+	msgpack::pack(keyed_source, keyed_packed);
+	msgpack::packed_map_index keyed(keyed_packed);
+	msgpack::view keyed_value(keyed_packed);
+	bool keyed_ok = keyed.size() == 100 && keyed.find(string("key_41"), keyed_value) && keyed_value.size() == 2 && keyed_value[1].as_int() == 41
+		&& keyed.contains("key_99") && !keyed.contains("key_100");
+	msgpack_byte::container keyed_short(keyed_packed.raw_pointer(), keyed_packed.size() - 1);
+	vector<int> not_keyed{ 1, 2 };
+	msgpack_byte::container keyed_array;
+	msgpack::pack(not_keyed, keyed_array);
+	keyed_ok = keyed_ok && throws<std::out_of_range>([&] { msgpack::packed_map_index index(keyed_short); })
+		&& throws<std::invalid_argument>([&] { msgpack::packed_map_index index(keyed_array); });
+	std::cout << "Packed map index: " << (keyed_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// reflection: msgpack_define packs an array in field order, msgpack_define_map a map by field name
+	sample_point point_source{ 7, "seven", { 0.5, -1.5 } }, point_result;
+	sample_record record_source{ 42, "answer" }, record_result;
+	msgpack_byte::container point_packed, record_packed;
+	msgpack::pack(point_source, point_packed);
+	msgpack::pack(record_source, record_packed);
+	msgpack::unpack(point_result, point_packed);
+	msgpack::unpack(record_result, record_packed);
+	msgpack::view record_view(record_packed);
+	bool reflect_ok = point_result.x == 7 && point_result.label == "seven" && point_result.weights == point_source.weights
+		&& record_result.id == 42 && record_result.name == "answer" && record_view["name"].as_string() == "answer";
+	msgpack_byte::container point_short(point_packed.raw_pointer(), point_packed.size() - 1);
+	reflect_ok = reflect_ok && throws<std::out_of_range>([&] { sample_point out; msgpack::unpack(out, point_short); })
+		&& throws<std::invalid_argument>([&] { sample_point out; msgpack::unpack(out, typed_packed); });
+	std::cout << "Reflection: " << (reflect_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// string_view and bin_view: payloads decoded as views pointing into the container instead of copies
+	const uint8_t blob[] = { 0x00, 0xff, 0x10 };
+	tuple<string, msgpack::bin_view> borrowed_source{ string(40, 's'), msgpack::bin_view(blob, sizeof(blob)) };
+	msgpack_byte::container borrowed_packed;
+	msgpack::pack(borrowed_source, borrowed_packed);
+	std::string_view borrowed_str;
+	msgpack::bin_view borrowed_bin;
+	uint64_t borrowed_pos = 1;
+	msgpack::unpack(borrowed_str, borrowed_packed, borrowed_pos);
+	msgpack::unpack(borrowed_bin, borrowed_packed, borrowed_pos);
+	const char* packed_begin = reinterpret_cast<const char*>(borrowed_packed.raw_pointer());
+	bool borrowed_ok = borrowed_str == get<0>(borrowed_source) && borrowed_str.data() > packed_begin && borrowed_str.data() < packed_begin + borrowed_packed.size()
+		&& borrowed_bin.size() == sizeof(blob) && memcmp(borrowed_bin.data(), blob, sizeof(blob)) == 0 && borrowed_pos == borrowed_packed.size();
+	msgpack_byte::container borrowed_short(borrowed_packed.raw_pointer(), borrowed_packed.size() - 1);
+	borrowed_ok = borrowed_ok && throws<std::out_of_range>([&] { uint64_t pos = 1; std::string_view str; msgpack::bin_view bin; msgpack::unpack(str, borrowed_short, pos); msgpack::unpack(bin, borrowed_short, pos); })
+		&& throws<std::invalid_argument>([&] { uint64_t pos = 0; std::string_view str; msgpack::unpack(str, borrowed_packed, pos); });
+	std::cout << "String and bin views: " << (borrowed_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// borrowed containers decode the source in place and copy it on the first write, the source is never written
+	const uint8_t borrowed_source_bytes[] = { 0x93, 0x01, 0x02, 0x03 };
+	msgpack_byte::container borrowing(borrowed_source_bytes, sizeof(borrowed_source_bytes));
+	vector<int> borrowed_values;
+	msgpack::unpack(borrowed_values, borrowing);
+	bool borrowing_ok = borrowing.borrowed() && borrowing.raw_pointer() == borrowed_source_bytes && borrowed_values == vector<int>{ 1, 2, 3 };
+	borrowing[1] = 0x07;
+	*borrowing.mutable_pointer(2) = 0x08;
+	msgpack::unpack(borrowed_values, borrowing);
+	borrowing_ok = borrowing_ok && !borrowing.borrowed() && borrowed_values == vector<int>{ 7, 8, 3 } && borrowed_source_bytes[1] == 0x01 && borrowed_source_bytes[2] == 0x02;
+	msgpack_byte::container borrowing_short(borrowed_source_bytes, sizeof(borrowed_source_bytes) - 1);
+	borrowing_ok = borrowing_ok && throws<std::out_of_range>([&] { vector<int> out; msgpack::unpack(out, borrowing_short); });
+	std::cout << "Borrowed container: " << (borrowing_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+#ifndef _WIN32
+	// mapped files: packed into and read from the page cache, a write to bytes() copies instead of touching the read-only mapping
+	const string mapped_path = "msgpack_test_mapped.bin";
+	vector<int> mapped_source{ 1, 2, 3 }, mapped_result;
+	{
+		msgpack_byte::mapped_sink mapped_out(mapped_path);
+		msgpack::pack(mapped_source, mapped_out);
+	}
+	bool mapped_ok = false;
+	{
+		msgpack_byte::mapped_file mapped_in(mapped_path);
+		msgpack_byte::container mapped_bytes = mapped_in.bytes();
+		msgpack::unpack(mapped_result, mapped_bytes);
+		mapped_ok = mapped_result == mapped_source && mapped_bytes.borrowed();
+		mapped_bytes[0] = 0x92; // two elements
+		msgpack::unpack(mapped_result, mapped_bytes);
+		mapped_ok = mapped_ok && mapped_result == vector<int>{ 1, 2 } && mapped_in.raw_pointer()[0] == 0x93;
+		msgpack_byte::container mapped_short(mapped_in.raw_pointer(), mapped_in.size() - 1);
+		mapped_ok = mapped_ok && throws<std::out_of_range>([&] { vector<int> out; msgpack::unpack(out, mapped_short); });
+	}
+	std::remove(mapped_path.c_str());
+	std::cout << "Mapped file: " << (mapped_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+#endif
+
+	// stream_unpacker: objects arriving a byte at a time are handed out as soon as their last byte is in
+	msgpack::stream_unpacker incoming(16);
+	size_t streamed = 0;
+	bool stream_ok = true;
+	for (size_t round = 0; round < 2; round++) {
+		for (size_t i = 0; i < index_packed.size(); i++) {
+			incoming.feed(index_packed.raw_pointer(i), 1);
+			stream_ok = stream_ok && incoming.ready() == (i + 1 == index_packed.size() ? 1 : 0);
+			decltype(index_source) streamed_value;
+			if (incoming.next(streamed_value)) {
+				stream_ok = stream_ok && streamed_value == index_source;
+				streamed++;
+			}
+		}
+	}
+	stream_ok = stream_ok && streamed == 2 && incoming.buffered() == 0;
+	const uint8_t never_used = 0xc1;
+	stream_ok = stream_ok && throws<std::invalid_argument>([&] { incoming.feed(&never_used, 1); });
+	incoming.reset();
+	incoming.feed(index_packed.raw_pointer(), index_packed.size() - 1);
+	stream_ok = stream_ok && incoming.ready() == 0 && incoming.buffered() == index_packed.size() - 1;
+	std::cout << "Stream unpacker: " << (stream_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// parse: callbacks for every value of index_source in order, nothing built
+	counting_visitor counted;
+	uint64_t parse_pos = 0;
+	msgpack::parse(index_packed, counted, parse_pos);
+	bool parse_ok = counted.ints == 5 && counted.strings == 2 && counted.string_bytes == 301 && counted.opened == 3 && counted.closed == 3
+		&& parse_pos == index_packed.size();
+	parse_ok = parse_ok && throws<std::out_of_range>([&] { counting_visitor v; msgpack::parse(index_short, v); })
+		&& throws<std::invalid_argument>([&] { counting_visitor v; uint64_t pos = 0; msgpack::parse(&never_used, 1, v, pos); });
+	std::cout << "Parse: " << (parse_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// object tree: schema-less decoding into a zone, counts past the end are rejected before the zone is sized by them
+	msgpack::zone tree_arena;
+	msgpack::object tree;
+	msgpack::unpack(tree, keyed_packed, tree_arena);
+	bool tree_ok = tree.type() == msgpack::kind::map && tree.size() == 100;
+	msgpack_byte::container tree_repacked;
+	msgpack::pack(tree, tree_repacked);
+	tree_ok = tree_ok && tree_repacked == keyed_packed;
+	const uint8_t huge_map[] = { 0xdf, 0x7f, 0xff, 0xff, 0xff }; // map32 claiming 2^31 - 1 entries
+	msgpack_byte::container huge_packed(huge_map, sizeof(huge_map));
+	msgpack_byte::container tree_short(keyed_packed.raw_pointer(), keyed_packed.size() - 1);
+	tree_ok = tree_ok && throws<std::out_of_range>([&] { msgpack::zone arena; msgpack::object out; msgpack::unpack(out, huge_packed, arena); })
+		&& throws<std::out_of_range>([&] { msgpack::zone arena; msgpack::object out; msgpack::unpack(out, tree_short, arena); });
+	std::cout << "Object tree: " << (tree_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// record log: checksummed blocks behind other bytes in the sink, opened through the index or recovered without it
+	msgpack_byte::container log_bytes;
+	string log_prefix = "not part of the log";
+	msgpack::pack(log_prefix, log_bytes);
+	{
+		msgpack::log_writer<msgpack_byte::container> log(log_bytes, 256);
+		for (int i = 0; i < 100; i++) {
+			log.append(i, int64_t(i) * 10);
+		}
+	}
+	msgpack::log_reader log_in(log_bytes);
+	int logged = 0;
+	log_in.read(57, logged);
+	bool log_ok = !log_in.recovered() && log_in.size() == 100 && log_in.block_index().size() > 1 && logged == 57 && log_in.timestamp(99) == 990
+		&& log_in.lower_bound(305) == 31;
+	msgpack_byte::container log_bad_footer = log_bytes;
+	memset(log_bad_footer.mutable_pointer(log_bad_footer.size() - 16), 0xff, 8); // index offset
+	msgpack::log_reader log_rebuilt(log_bad_footer);
+	msgpack_byte::container log_torn(log_bytes.raw_pointer(), log_bytes.size() / 2);
+	msgpack::log_reader log_partial(log_torn);
+	log_partial.read(0, logged);
+	log_ok = log_ok && log_rebuilt.recovered() && log_rebuilt.size() == 100 && log_partial.recovered() && logged == 0
+		&& throws<std::out_of_range>([&] { log_partial.record(99); });
+	std::cout << "Record log: " << (log_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// block compression: lz blocks restored in order or in parallel, damaged blocks are rejected before anything is sized
+	msgpack::lz_codec lz;
+	msgpack_byte::container compressed, restored, restored_parallel;
+	msgpack::compress(keyed_packed, compressed, lz, 256);
+	msgpack::decompress(compressed, restored);
+	msgpack::decompress(compressed, restored_parallel, 2);
+	bool compress_ok = compressed.size() < keyed_packed.size() && restored == keyed_packed && restored_parallel == keyed_packed;
+	msgpack_byte::container compressed_short(compressed.raw_pointer(), compressed.size() - 1);
+	msgpack_byte::container unknown_codec = compressed, oversized = compressed;
+	unknown_codec[0] = 0xee;
+	memset(oversized.mutable_pointer(1), 0x7f, 4); // original length of the first block
+	compress_ok = compress_ok && throws<std::out_of_range>([&] { msgpack_byte::container out; msgpack::decompress(compressed_short, out); })
+		&& throws<std::invalid_argument>([&] { msgpack_byte::container out; msgpack::decompress(unknown_codec, out); })
+		&& throws<std::invalid_argument>([&] { msgpack_byte::container out; msgpack::decompress(oversized, out); });
+	std::cout << "Compression: " << (compress_ok ? "ok" : "failed!") << " (ok expected)" << endl;
+
+	// pack_fixed: small scalar tuples into a stack buffer bounded at compile time, same bytes as pack
+	tuple<uint64_t, int32_t, double, bool> fixed_source{ 1700000000, -3, 0.25, true }, fixed_result;
+	msgpack::fixed_buffer<decltype(fixed_source)> fixed_bytes;
+	size_t fixed_n = msgpack::pack_fixed(fixed_source, fixed_bytes);
+	msgpack_byte::container fixed_packed;
+	msgpack::pack(fixed_source, fixed_packed);
+	msgpack_byte::container fixed_in(fixed_bytes.data(), fixed_n);
+	msgpack::unpack(fixed_result, fixed_in);
+	bool fixed_ok = fixed_bytes.size() == 25 && fixed_n == fixed_packed.size() && memcmp(fixed_bytes.data(), fixed_packed.raw_pointer(), fixed_n) == 0
+		&& fixed_result == fixed_source;
+	msgpack_byte::container fixed_short(fixed_bytes.data(), fixed_n - 1);
+	fixed_ok = fixed_ok && throws<std::out_of_range>([&] { decltype(fixed_source) out; msgpack::unpack(out, fixed_short); });
+	std::cout << "Fixed size packing: " << (fixed_ok ? "ok" : "failed!") << " (ok expected)" << endl;
 	return 0;
 }
\ No newline at end of file
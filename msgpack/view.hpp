@@ -0,0 +1,435 @@
+#ifndef VIEW_HPP
+#define VIEW_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <limits>
+#include <vector>
+#include <functional>
+
+#include "msgpack.hpp"
+
+namespace msgpack {
+	// read-only cursor over packed bytes, values are decoded on access and nothing is allocated
+
+	class view {
+	public:
+
+		view(container& src, uint64_t pos = 0) : data(src.raw_pointer()), s(src.size()), p(pos) {};
+		view(const uint8_t* src, size_t len, uint64_t pos = 0) : data(src), s(len), p(pos) {};
+
+		// inspection
+
+		kind type() const {
+			return header(p).k;
+		}
+		// elements of an array or map, bytes of a str, bin or ext data, 0 for scalars
+		size_t size() const {
+			head h = header(p);
+			switch (h.k) {
+			case kind::array:
+			case kind::map:
+			case kind::str:
+			case kind::bin: {
+				return size_t(h.n);
+			}
+			case kind::ext: {
+				return size_t(h.n - 1);
+			}
+			default: {
+				return 0;
+			}
+			}
+		}
+		uint64_t offset() const {
+			return p;
+		}
+		// offset just past this value, including everything nested in it
+		uint64_t next_offset() const {
+			return skip_value(data, s, p);
+		}
+		bool is_nil() const {
+			return type() == kind::null;
+		}
+
+		// typed accessors
+
+		bool as_bool() const {
+			head h = header(p);
+			if (h.k != kind::boolean) {
+				throw std::invalid_argument("not a bool!");
+			}
+			return h.n != 0;
+		}
+		uint64_t as_uint() const {
+			head h = header(p);
+			if (h.k == kind::uint) {
+				return h.n;
+			}
+			if (h.k == kind::sint && int64_t(h.n) >= 0) {
+				return h.n;
+			}
+			throw std::range_error("not an unsigned integer!");
+		}
+		int64_t as_int() const {
+			head h = header(p);
+			if (h.k == kind::sint || (h.k == kind::uint && h.n <= uint64_t(posmax64))) {
+				return int64_t(h.n);
+			}
+			throw std::range_error("not a signed integer!");
+		}
+		double as_double() const {
+			head h = header(p);
+			const uint8_t* payload = data + p + h.len;
+			switch (h.k) {
+			case kind::f32: {
+				return double(read_d_word<float>(payload));
+			}
+			case kind::f64: {
+				return read_q_word<double>(payload);
+			}
+			case kind::uint: {
+				return double(h.n);
+			}
+			case kind::sint: {
+				return double(int64_t(h.n));
+			}
+			default: {
+				throw std::invalid_argument("not a number!");
+			}
+			}
+		}
+		// str and bin payloads, pointing into the packed bytes
+		std::string_view as_string() const {
+			head h = header(p);
+			if (h.k != kind::str && h.k != kind::bin) {
+				throw std::invalid_argument("not a string!");
+			}
+			return std::string_view(reinterpret_cast<const char*>(data + p + h.len), size_t(h.n));
+		}
+		bin_view as_bin() const {
+			std::string_view bytes = as_string();
+			return bin_view(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+		}
+		char as_char() const {
+			std::string_view str = as_string();
+			if (str.size() != 1) {
+				throw std::invalid_argument("not a char!");
+			}
+			return str[0];
+		}
+
+		template<typename T>
+		T as() const {
+			if constexpr (std::is_same<T, bool>::value) {
+				return as_bool();
+			}
+			else if constexpr (std::is_same<T, char>::value) {
+				return as_char();
+			}
+			else if constexpr (std::is_integral<T>::value && std::is_unsigned<T>::value) {
+				uint64_t n = as_uint();
+				if (n > std::numeric_limits<T>::max()) {
+					throw std::range_error(std::to_string(n) + " out of range!");
+				}
+				return T(n);
+			}
+			else if constexpr (std::is_integral<T>::value) {
+				int64_t n = as_int();
+				if (n < std::numeric_limits<T>::min() || n > std::numeric_limits<T>::max()) {
+					throw std::range_error(std::to_string(n) + " out of range!");
+				}
+				return T(n);
+			}
+			else if constexpr (std::is_floating_point<T>::value) {
+				return T(as_double());
+			}
+			else if constexpr (std::is_same<T, std::string_view>::value) {
+				return as_string();
+			}
+			else {
+				static_assert(std::is_same<T, std::string>::value, "view::as supports scalars and strings, use unpack for containers");
+				return std::string(as_string());
+			}
+		}
+
+		// navigation
+
+		class iterator {
+		public:
+
+			using iterator_category = std::forward_iterator_tag;
+			using difference_type = std::ptrdiff_t;
+			using value_type = view;
+			using pointer = void;
+			using reference = view;
+
+			iterator(const uint8_t* src, size_t len, uint64_t pos, uint64_t remaining, bool map) : data(src), s(len), p(pos), left(remaining), pairs(map) {};
+
+			// element of an array, key of a map
+			view operator*() const {
+				return view(data, s, p);
+			}
+			view key() const {
+				return view(data, s, p);
+			}
+			// value of a map entry
+			view value() const {
+				return view(data, s, skip_value(data, s, p));
+			}
+			iterator& operator++() {
+				p = skip_value(data, s, p);
+				if (pairs) {
+					p = skip_value(data, s, p);
+				}
+				left--;
+				return *this;
+			}
+			iterator operator++(int) {
+				iterator tmp = *this;
+				++(*this);
+				return tmp;
+			}
+			friend bool operator== (const iterator& a, const iterator& b) {
+				return a.left == b.left;
+			}
+			friend bool operator!= (const iterator& a, const iterator& b) {
+				return a.left != b.left;
+			}
+
+		private:
+
+			const uint8_t* data;
+			size_t s;
+			uint64_t p;
+			uint64_t left;
+			bool pairs;
+		};
+
+		// iterates the elements of an array or the entries of a map
+		iterator begin() const {
+			head h = header(p);
+			if (h.k != kind::array && h.k != kind::map) {
+				throw std::invalid_argument("not an array or map!");
+			}
+			return iterator(data, s, p + h.len, h.n, h.k == kind::map);
+		}
+		iterator end() const {
+			return iterator(data, s, 0, 0, false);
+		}
+
+		// i-th element of an array, O(i), use build_index for repeated random access
+		view operator[](size_t i) const {
+			head h = header(p);
+			if (h.k != kind::array) {
+				throw std::invalid_argument("not an array!");
+			}
+			if (i >= h.n) {
+				throw std::out_of_range(std::to_string(i) + " out of range!");
+			}
+			uint64_t pos = p + h.len;
+			for (size_t j = 0; j < i; j++) {
+				pos = skip_value(data, s, pos);
+			}
+			return view(data, s, pos);
+		}
+		// value stored under a string key of a map
+		view operator[](std::string_view key) const {
+			view result(data, s, 0);
+			if (!find(key, result)) {
+				throw std::out_of_range(std::string(key) + " not found!");
+			}
+			return result;
+		}
+		template<typename K>
+		bool find(const K& key, view& result) const {
+			if (type() != kind::map) {
+				throw std::invalid_argument("not a map!");
+			}
+			for (iterator it = begin(); it != end(); ++it) {
+				if (matches(it.key(), key)) {
+					result = it.value();
+					return true;
+				}
+			}
+			return false;
+		}
+		template<typename K>
+		bool contains(const K& key) const {
+			view result(data, s, 0);
+			return find(key, result);
+		}
+
+		// advances over one complete value starting at pos, returns the offset after it
+		static uint64_t skip_value(const uint8_t* data, size_t len, uint64_t pos) {
+			skip(data, len, pos);
+			return pos;
+		}
+
+		// header decoding, msgpack::read_header bounds the header and its payload
+
+		using head = header_info;
+
+		static head header(const uint8_t* data, size_t s, uint64_t pos) {
+			return read_header(data, s, pos);
+		}
+
+	private:
+
+		head header(uint64_t pos) const {
+			return read_header(data, s, pos);
+		}
+
+		template<typename K>
+		static bool matches(const view& candidate, const K& key) {
+			if constexpr (std::is_integral<K>::value && !std::is_same<K, bool>::value && !std::is_same<K, char>::value) {
+				kind k = candidate.type();
+				if (k == kind::uint) {
+					return key >= 0 && candidate.as_uint() == uint64_t(key);
+				}
+				return k == kind::sint && candidate.as_int() == int64_t(key);
+			}
+			else if constexpr (std::is_same<K, char>::value) {
+				kind k = candidate.type();
+				return k == kind::str && candidate.size() == 1 && candidate.as_char() == key;
+			}
+			else {
+				kind k = candidate.type();
+				return k == kind::str && candidate.as_string() == std::string_view(key);
+			}
+		}
+
+		friend class packed_map_index;
+
+		const uint8_t* data;
+		size_t s;
+		uint64_t p;
+	};
+
+	// read-only hash index over one packed map, built in a single pass over its keys (string payloads are hashed in place,
+	// integer keys by value) so find() is O(1) and decodes nothing but the matching key, the value comes back as a view
+	// valid while the source bytes are
+
+	class packed_map_index {
+	public:
+
+		packed_map_index(container& src, uint64_t pos = 0) : packed_map_index(src.raw_pointer(), src.size(), pos) {};
+		packed_map_index(const uint8_t* src, size_t len, uint64_t pos = 0) : data(src), s(len), index(build_index(src, len, pos)) {
+			if (!index.pairs) {
+				throw std::invalid_argument("not a map!");
+			}
+			size_t n = index.size();
+			if (n > 0xFFFFFFFE) {
+				throw std::range_error(std::to_string(n) + " out of range!");
+			}
+			// power of two with at most half of the slots taken, linear probing keeps the first of duplicate keys in front
+			size_t slots = 16;
+			while (slots < n * 2) {
+				slots *= 2;
+			}
+			mask = slots - 1;
+			table.assign(slots, 0);
+			for (size_t i = 0; i < n; i++) {
+				uint64_t h = key_hash(view(data, s, index[i]));
+				size_t slot = size_t(h) & mask;
+				while (table[slot] != 0) {
+					slot = (slot + 1) & mask;
+				}
+				table[slot] = (h & 0xFFFFFFFF00000000) | uint64_t(i + 1);
+			}
+		};
+
+		size_t size() const {
+			return index.size();
+		}
+
+		// lookups by integer, char or string key (std::string, std::string_view, const char*)
+		template<typename K>
+		bool find(const K& key, view& result) const {
+			uint64_t h = query_hash(key);
+			size_t slot = size_t(h) & mask;
+			while (table[slot] != 0) {
+				uint64_t entry = table[slot];
+				if ((entry & 0xFFFFFFFF00000000) == (h & 0xFFFFFFFF00000000)) {
+					size_t i = size_t(entry & 0xFFFFFFFF) - 1;
+					if (view::matches(view(data, s, index[i]), key)) {
+						result = view(data, s, index.value(i));
+						return true;
+					}
+				}
+				slot = (slot + 1) & mask;
+			}
+			return false;
+		}
+		template<typename K>
+		view operator[](const K& key) const {
+			view result(data, s, 0);
+			if (!find(key, result)) {
+				throw std::out_of_range("key not found!");
+			}
+			return result;
+		}
+		template<typename K>
+		bool contains(const K& key) const {
+			view result(data, s, 0);
+			return find(key, result);
+		}
+
+	private:
+
+		static uint64_t hash_integer(uint64_t value) {
+			// splitmix64 finalizer
+			value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+			value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+			return value ^ (value >> 31);
+		}
+		static uint64_t hash_bytes(std::string_view bytes) {
+			return hash_integer(uint64_t(std::hash<std::string_view>()(bytes)));
+		}
+
+		// uint and sint keys of the same value hash alike, like view::find compares them
+		uint64_t key_hash(const view& key) const {
+			switch (key.type()) {
+			case kind::uint: {
+				return hash_integer(key.as_uint());
+			}
+			case kind::sint: {
+				return hash_integer(uint64_t(key.as_int()));
+			}
+			case kind::str: {
+				return hash_bytes(key.as_string());
+			}
+			default: {
+				// other key types cannot be looked up, they only need a slot
+				uint64_t end = view::skip_value(data, s, key.offset());
+				return hash_bytes(std::string_view(reinterpret_cast<const char*>(data + key.offset()), size_t(end - key.offset())));
+			}
+			}
+		}
+		template<typename K>
+		static uint64_t query_hash(const K& key) {
+			if constexpr (std::is_integral<K>::value && !std::is_same<K, bool>::value && !std::is_same<K, char>::value) {
+				return hash_integer(uint64_t(int64_t(key)));
+			}
+			else if constexpr (std::is_same<K, char>::value) {
+				return hash_bytes(std::string_view(&key, 1));
+			}
+			else {
+				return hash_bytes(std::string_view(key));
+			}
+		}
+
+		const uint8_t* data;
+		size_t s;
+		offset_index index;
+		std::vector<uint64_t> table; // upper 32 bits of the key hash, entry + 1 below, 0 for empty slots
+		size_t mask;
+	};
+};
+
+#endif
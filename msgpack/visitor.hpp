@@ -0,0 +1,151 @@
+#ifndef VISITOR_HPP
+#define VISITOR_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "msgpack.hpp"
+#include "view.hpp"
+
+namespace msgpack {
+	// callbacks fired by msgpack::parse, derive from it and hide the ones of interest (dispatch is static, nothing is
+	// virtual), strings, binary and ext data point into the packed bytes
+
+	struct visitor {
+		void on_nil() { }
+		void on_bool(bool) { }
+		void on_uint(uint64_t) { }
+		void on_int(int64_t) { } // signed formats, negative fixints included
+		void on_float(float) { }
+		void on_double(double) { }
+		void on_str(std::string_view) { }
+		void on_bin(bin_view) { }
+		void on_ext(int8_t, bin_view) { } // type and data
+		void on_array_begin(size_t) { } // followed by that many values
+		void on_array_end() { }
+		void on_map_begin(size_t) { } // followed by that many keys and values in turn
+		void on_map_end() { }
+	};
+
+	// walks one complete value at pos and fires the callbacks of visitor in order, pos ends up after the value, nothing
+	// is allocated and nesting is tracked in a fixed stack of parse_depth levels
+	template<typename Visitor>
+	void parse(const uint8_t* data, size_t len, Visitor& visitor, uint64_t& pos) {
+		uint64_t remaining[parse_depth]; // values left in each open array or map
+		bool pairs[parse_depth];
+		size_t depth = 0;
+		while (true) {
+			header_info h = read_header(data, len, pos);
+			msgpack_count_decode(data[pos]);
+			bool opened = false;
+			switch (h.k) {
+			case kind::null: {
+				visitor.on_nil();
+				pos += h.len;
+				break;
+			}
+			case kind::boolean: {
+				visitor.on_bool(h.n != 0);
+				pos += h.len;
+				break;
+			}
+			case kind::uint: {
+				visitor.on_uint(h.n);
+				pos += h.len;
+				break;
+			}
+			case kind::sint: {
+				visitor.on_int(int64_t(h.n));
+				pos += h.len;
+				break;
+			}
+			case kind::array:
+			case kind::map: {
+				// every element takes at least a byte, so a corrupt count is rejected before a visitor sizes anything by it
+				if (h.elements() > len - pos - h.len) {
+					throw std::out_of_range("element count at " + std::to_string(pos) + " out of range!");
+				}
+				bool map = h.k == kind::map;
+				if (map) {
+					visitor.on_map_begin(size_t(h.n));
+				}
+				else {
+					visitor.on_array_begin(size_t(h.n));
+				}
+				pos += h.len;
+				if (h.n == 0) {
+					if (map) {
+						visitor.on_map_end();
+					}
+					else {
+						visitor.on_array_end();
+					}
+				}
+				else {
+					if (depth == parse_depth) {
+						throw std::out_of_range("nesting deeper than " + std::to_string(parse_depth) + "!");
+					}
+					remaining[depth] = map ? h.n * 2 : h.n;
+					pairs[depth] = map;
+					depth++;
+					opened = true;
+				}
+				break;
+			}
+			default: {
+				// the payload follows the header, read_header bounded it
+				const uint8_t* payload = data + pos + h.len;
+				if (h.k == kind::f32) {
+					visitor.on_float(read_d_word<float>(payload));
+				}
+				else if (h.k == kind::f64) {
+					visitor.on_double(read_q_word<double>(payload));
+				}
+				else if (h.k == kind::str) {
+					visitor.on_str(std::string_view(reinterpret_cast<const char*>(payload), size_t(h.n)));
+				}
+				else if (h.k == kind::bin) {
+					visitor.on_bin(bin_view(payload, size_t(h.n)));
+				}
+				else {
+					visitor.on_ext(int8_t(payload[0]), bin_view(payload + 1, size_t(h.n - 1)));
+				}
+				pos += h.len + h.n;
+				break;
+			}
+			}
+			if (opened) {
+				continue;
+			}
+			// a value is complete, close every array and map it completes
+			while (depth > 0 && --remaining[depth - 1] == 0) {
+				depth--;
+				if (pairs[depth]) {
+					visitor.on_map_end();
+				}
+				else {
+					visitor.on_array_end();
+				}
+			}
+			if (depth == 0) {
+				return;
+			}
+		}
+	}
+
+	template<typename Visitor>
+	void parse(container& src, Visitor& visitor, uint64_t& pos) {
+		parse(src.raw_pointer(), src.size(), visitor, pos);
+	}
+
+	template<typename Visitor>
+	void parse(container& src, Visitor& visitor) {
+		uint64_t pos = 0;
+		parse(src.raw_pointer(), src.size(), visitor, pos);
+	}
+};
+
+#endif